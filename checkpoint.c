@@ -0,0 +1,207 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * checkpoint.c - A score table that keeps only every stride-th column,
+ *                for constructing alignments in less than quadratic
+ *                memory.  With stride about the square root of the top
+ *                string's length, the checkpoints and the window for
+ *                rescoring one strip between them each take about
+ *                N * sqrt(M) scores.
+ *
+ *                The forward fill scores the table strip by strip in
+ *                the window, saving the last column of each strip as
+ *                the next checkpoint.  During traceback, a cell's
+ *                directions are derived from the scores of its strip
+ *                (see derive_walk_cell() in score-kernel.c), which is
+ *                rescored from its checkpoint whenever the walk moves
+ *                into a strip other than the one in the window.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "checkpoint.h"
+#include "computation.h"
+#include "dbg.h"
+#include "kernels.h"
+#include "score-kernel.h"
+#include "score-table.h"
+
+/*
+ * alloc_checkpoint_table()
+ *
+ *   Allocate a checkpoint_table_t for aligning s1 (the top string)
+ *   against s2 with linear gaps.  See init_computation() for the
+ *   parameters.
+ *
+ *   return - allocated pointer to a checkpoint_table_t
+ */
+checkpoint_table_t *
+alloc_checkpoint_table(char *s1,
+                       char *s2,
+                       int m,
+                       int k,
+                       int d,
+                       const substitution_matrix_t *matrix)
+{
+        checkpoint_table_t *K =
+                (checkpoint_table_t *)malloc(sizeof(checkpoint_table_t));
+        check(NULL != K, "malloc failed");
+
+        K->M = strlen(s1) + 1;
+        K->N = strlen(s2) + 1;
+        /* The stride is the square root of M - 1, rounded up */
+        K->stride = 1;
+        while ((long)K->stride * K->stride < K->M - 1) {
+                K->stride = K->stride + 1;
+        }
+        K->top_string = s1;
+        K->strip_index = -1;
+        K->score = 0;
+
+        size_t num_columns = (size_t)(K->M - 1) / K->stride + 1;
+        K->columns = (int *)malloc(num_columns * K->N * sizeof(int));
+        check(NULL != K->columns, "malloc failed");
+
+        /* The strip computation is an ordinary one without a walk
+           table, for a top string of stride characters that
+           score_strip() fills in */
+        K->strip_top = (char *)malloc(K->stride + 1);
+        check(NULL != K->strip_top, "malloc failed");
+        memset(K->strip_top, 'A', K->stride);
+        K->strip_top[K->stride] = '\0';
+        K->strip = alloc_computation();
+        init_computation(K->strip, K->strip_top, s2, m, k, d, d, matrix, 1,
+                         -1, -1, keep_score_table);
+        K->strip->score_column = choose_column_kernel(get_kernels(),
+                                                      K->strip);
+
+        /* Column 0 is the first checkpoint */
+        for (int row = 0; row < K->N; row++) {
+                K->columns[row] = -row * d;
+        }
+
+        return K;
+}
+
+/*
+ * score_strip()
+ *
+ *   Score strip s of a checkpoint table in its window, from the
+ *   checkpoint before it.
+ *
+ *   return - number of columns in the strip
+ */
+static int
+score_strip(checkpoint_table_t *K, int s)
+{
+        computation_t *C = K->strip;
+        score_table_t *S = C->score_table;
+        int first_col = s * K->stride;
+        int width = K->M - 1 - first_col;
+        if (width > K->stride) {
+                width = K->stride;
+        }
+
+        memcpy(K->strip_top, K->top_string + first_col, width);
+        memcpy(score_table_column(S, 0), &K->columns[(size_t)s * K->N],
+               K->N * sizeof(int));
+        for (int col = 1; col <= width; col++) {
+                score_table_set(S, col, 0,
+                                -(first_col + col) * C->indel_penalty);
+                C->score_column(C, col, 1, K->N - 1);
+        }
+
+        K->strip_index = s;
+        return width;
+}
+
+/*
+ * fill_checkpoint_table()
+ *
+ *   Score a checkpoint table strip by strip, keeping the last column of
+ *   each full strip as a checkpoint and the score of the bottom-right
+ *   cell.
+ *
+ *   K - target checkpoint table
+ */
+void
+fill_checkpoint_table(checkpoint_table_t *K)
+{
+        score_table_t *S = K->strip->score_table;
+
+        if (K->M == 1) {
+                K->score = K->columns[K->N - 1];
+                return;
+        }
+
+        for (int s = 0; s * K->stride < K->M - 1; s++) {
+                int width = score_strip(K, s);
+                int *last = score_table_column(S, width);
+                if (width == K->stride) {
+                        memcpy(&K->columns[(size_t)(s + 1) * K->N], last,
+                               K->N * sizeof(int));
+                }
+                K->score = last[K->N - 1];
+        }
+}
+
+/*
+ * checkpoint_walk_cell()
+ *
+ *   Return the optimal directions out of the cell at (col, row) of a
+ *   filled checkpoint table, rescoring the cell's strip if the window
+ *   holds another.
+ */
+walk_table_cell_t
+checkpoint_walk_cell(checkpoint_table_t *K, int col, int row)
+{
+        if (col == 0) {
+                return derive_walk_cell(K->strip, 0, row);
+        }
+
+        int s = (col - 1) / K->stride;
+        if (s != K->strip_index) {
+                score_strip(K, s);
+        }
+        return derive_walk_cell(K->strip, col - s * K->stride, row);
+}
+
+void
+free_checkpoint_table(checkpoint_table_t *K)
+{
+        free_computation(K->strip);
+        free(K->strip_top);
+        free(K->columns);
+        free(K);
+}
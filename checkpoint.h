@@ -0,0 +1,95 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * checkpoint.h - Definition of the checkpointed score table and
+ *                prototypes for the functions in checkpoint.c that fill
+ *                it and recompute its strips during traceback.
+ */
+
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include "computation.h"
+#include "walk-table.h"
+
+/* checkpoint_table_t: Every stride-th column of an MxN score table,
+ *                     with a window of stride + 1 columns in which one
+ *                     strip of the table at a time is rescored.  Strip
+ *                     s holds the columns s*stride + 1 through
+ *                     (s+1)*stride, and its scores follow from
+ *                     checkpointed column s*stride. */
+typedef struct checkpoint_table {
+        int M;
+        int N;
+        int stride;
+
+        /* Checkpointed columns 0, stride, 2*stride, ..., N scores
+         * each */
+        int *columns;
+
+        /* Top string of the whole table */
+        const char *top_string;
+
+        /* Computation scoring one strip, with the strip's part of the
+         * top string in strip_top and the checkpoint it starts from
+         * in column 0 of its score table */
+        char *strip_top;
+        computation_t *strip;
+
+        /* Strip whose scores the window holds, or -1 */
+        int strip_index;
+
+        /* Score of the bottom-right cell */
+        int score;
+} checkpoint_table_t;
+
+/*
+ * Prototypes
+ */
+
+checkpoint_table_t *alloc_checkpoint_table(char *s1,
+                                           char *s2,
+                                           int m,
+                                           int k,
+                                           int d,
+                                           const substitution_matrix_t *matrix);
+
+void fill_checkpoint_table(checkpoint_table_t *K);
+
+walk_table_cell_t checkpoint_walk_cell(checkpoint_table_t *K,
+                                       int col,
+                                       int row);
+
+void free_checkpoint_table(checkpoint_table_t *K);
+
+#endif /* __CHECKPOINT_H__ */
@@ -35,8 +35,12 @@
  *                 instance of a Needleman-Wunsch alignment computation.
  */
 
+#include "checkpoint.h"
 #include "computation.h"
 #include "dbg.h"
+#include "kernels.h"
+#include "path-count.h"
+#include "score-kernel.h"
 #include "stdlib.h"
 #include "score-table.h"
 #include "walk-table.h"
@@ -65,63 +69,42 @@ alloc_computation()
  *
  *   S - scores table to initialize
  *
- *   W - walk table to initialize
+ *   W - walk table to initialize, or NULL if the computation keeps
+ *       none
  *
  *   d - indel penalty (used to initialize the top-most row and left-most
  *       column with seed values for the scoring run
  *
- *   nthreads - number of threads we're using for this computation
+ *   e - gap extension penalty, equal to d for linear gaps
  */
 void
-init_computation_tables(score_table_t *S, walk_table_t *W, int d, unsigned int nthreads)
+init_computation_tables(score_table_t *S, walk_table_t *W, int d, int e)
 {
-        /* Initialize all mutex and condition variables. */
-        int res;
-        if (nthreads > 1) {
-                for (int i = 0; i < S->M; i++) {
-                        for (int j = 0; j < S->N; j++) {
-                                res = pthread_mutex_init(&S->cells[i][j].score_mutex, NULL);
-                                check(0 == res, "pthread_mutex_init failed");
-                                res = pthread_cond_init (&S->cells[i][j].processed_cv, NULL);
-                                check(0 == res, "pthread_cond_init failed");
-                        }
-                }
-        }
-
-        /* Initialize the largest value. */
-        S->greatest_abs_val = 0;
-
         /* Initialize the table.  Cell (0,0) has a score of 0 and no
            optimal direction. */
-        S->cells[0][0].score = 0;
-        S->cells[0][0].processed = 1;
-        W->cells[0][0].up_done = 1;
-        W->cells[0][0].left_done = 1;
-        W->cells[0][0].diag_done = 1;
+        score_table_set(S, 0, 0, 0);
 
         /* The rest of the topmost row has score i * (-d) and LEFT
-         * direction. */
-        for (int i = 1; i < S->M; i++) {
-                S->cells[i][0].score = i * (-d);
-                S->cells[i][0].processed = 1;
-                W->cells[i][0].left = 1;
-                W->cells[i][0].up_done = 1;
-                W->cells[i][0].diag_done = 1;
+         * direction, or -d - (i-1) * e with affine gaps: one gap opens
+         * and extends to the right.  In a banded table, only the cells
+         * in the band are set. */
+        for (int i = 1; i < S->M && 0 == score_table_first_row(S, i); i++) {
+                score_table_set(S, i, 0, -d - (i - 1) * e);
+                if (NULL != W) {
+                        *walk_table_cell(W, i, 0) = walk_left |
+                                (i == 1 ? left_gap_open : left_gap_extend);
+                }
         }
 
         /* The rest of the leftmost column has score j * (-d) and UP
-         * direction. */
-        for (int j = 1; j < S->N; j++) {
-                S->cells[0][j].score = j * (-d);
-                S->cells[0][j].processed = 1;
-                W->cells[0][j].up = 1;
-                W->cells[0][j].left_done = 1;
-                W->cells[0][j].diag_done = 1;
+         * direction, or the affine equivalent. */
+        for (int j = 1; j <= score_table_last_row(S, 0); j++) {
+                score_table_set(S, 0, j, -d - (j - 1) * e);
+                if (NULL != W) {
+                        *walk_table_cell(W, 0, j) = walk_up |
+                                (j == 1 ? up_gap_open : up_gap_extend);
+                }
         }
-
-        W->branch_count = 0;
-        res = pthread_rwlock_init(&(W->branch_count_rwlock), NULL);
-        check(0 == res, "pthread_rwlock_init failed");
 }
 
 /* init_computation()
@@ -138,7 +121,25 @@ init_computation_tables(score_table_t *S, walk_table_t *W, int d, unsigned int n
  *
  *   k -  mismatch penalty
  *
- *   d -  indel, i.e. gap, penalty
+ *   d -  indel, i.e. gap, penalty; with affine gaps, the penalty
+ *        for opening a gap
+ *
+ *   e -  penalty for extending a gap, equal to d for linear gaps
+ *
+ *   matrix - substitution matrix to score aligned characters with in
+ *            place of m and k, or NULL
+ *
+ *   nthreads - number of threads to score the table with
+ *
+ *   band - half-width of the band of cells to score, or -1 to score
+ *          every cell
+ *
+ *   xdrop - X-drop threshold, or -1 to score every cell (in the band)
+ *
+ *   tables - the tables to keep while scoring (see tables_t).  With
+ *            keep_score_table or keep_checkpoints, the directions are
+ *            derived from the scores when they are needed (see
+ *            derive_walk_cell() in score-kernel.c).
  *
  *   return - initialized computational instance
  */
@@ -149,7 +150,12 @@ init_computation(computation_t *C,
                  int m,
                  int k,
                  int d,
-                 unsigned int nthreads)
+                 int e,
+                 const substitution_matrix_t *matrix,
+                 unsigned int nthreads,
+                 int band,
+                 int xdrop,
+                 tables_t tables)
 {
         /* We use an MxN table (M cols, N rows).  We add 1 to each of
            the input strings' lengths to make room for the base row and
@@ -160,122 +166,232 @@ init_computation(computation_t *C,
         int N = strlen(s2) + 1;
         debug("Side string is %d characters long", N-1);
 
-        /* Create and initialize the scores table */
-        debug("Allocating score table");
-        C->score_table = alloc_score_table(M, N);
-        debug("Allocating walk table");
-        C->walk_table = alloc_walk_table(M, N);
-        debug("Initializing score and walk tables");
-        init_computation_tables(C->score_table, C->walk_table, d, nthreads);
+        /* The bottom-right corner must lie in the band.  A band that
+           covers every cell is no band at all, so we store the whole
+           table instead. */
+        C->band = band;
+        C->touched_band_edge = 0;
+        if (band >= 0) {
+                check(abs(M - N) <= band, "the band of width %d misses "
+                      "the last cell; the strings' lengths differ by %d",
+                      band, abs(M - N));
+                if (band >= M - 1 && band >= N - 1) {
+                        band = -1;
+                }
+        }
+
+        C->xdrop = xdrop;
+        C->cells_scored = 0;
+
+        /* Create and initialize the scores table, or the checkpoints
+           standing in for it */
+        C->score_table = NULL;
+        C->walk_table = NULL;
+        C->checkpoints = NULL;
+        if (tables == keep_checkpoints) {
+                debug("Allocating checkpoint table");
+                C->checkpoints = alloc_checkpoint_table(s1, s2, m, k, d,
+                                                        matrix);
+        } else {
+                debug("Allocating score table");
+                C->score_table = alloc_score_table(M, N, band);
+                if (tables == keep_walk_table) {
+                        debug("Allocating walk table");
+                        C->walk_table = alloc_walk_table(M, N, band,
+                                                         nthreads);
+                }
+                debug("Initializing score and walk tables");
+                init_computation_tables(C->score_table, C->walk_table, d,
+                                        e);
+        }
 
-        /* Alignment strings */
+        /* Alignment strings.  The kernels sweep the side string once
+           per column, so we pack it if it is DNA; with a substitution
+           matrix they read the query profile instead. */
         C->top_string = s1;
         C->side_string = s2;
+        C->packed_side = NULL == matrix ? pack_sequence(s2) : NULL;
 
         /* Alignment scores/penalties */
         C->match_score = m;
         C->mismatch_penalty = k;
         C->indel_penalty = d;
+        C->gap_extend_penalty = e;
 
-        /* Total number of solutions found */
-        C->solution_count = 0;
-        if (nthreads > 1) {
-                int res = pthread_rwlock_init(&(C->solution_count_rwlock), NULL);
-                check(0 == res, "pthread_rwlock_init failed");
+        /* With a substitution matrix, the column kernels look up each
+           diagonal bonus in the side string's query profile */
+        C->matrix = matrix;
+        C->query_profile = NULL;
+        if (NULL != matrix) {
+                C->query_profile = alloc_query_profile(matrix, s2);
         }
 
-        /* Number of threads to use in the scoring step */
+        /* Gap scores carried between runs of the affine column kernel.
+           No alignment ends in a gap before the first cell is scored. */
+        C->left_gap_scores = NULL;
+        C->up_gap_scores = NULL;
+        if (e != d) {
+                C->left_gap_scores = (int *)malloc(N * sizeof(int));
+                C->up_gap_scores = (int *)malloc(M * sizeof(int));
+                check(NULL != C->left_gap_scores &&
+                      NULL != C->up_gap_scores, "malloc failed");
+                for (int j = 0; j < N; j++) {
+                        C->left_gap_scores[j] = SCORE_NEG_INF;
+                }
+                for (int i = 0; i < M; i++) {
+                        C->up_gap_scores[i] = SCORE_NEG_INF;
+                }
+        }
+
+        /* Number of threads to use in the scoring step, the pool they
+           run in, and the tile grid they share */
         C->num_threads = nthreads;
+        C->pool = NULL;
+        C->wavefront = NULL;
+        if (nthreads > 1) {
+                C->pool = alloc_thread_pool(nthreads);
+                C->wavefront = alloc_wavefront(M, N, nthreads);
+        }
 
         return C;
 }
 
 /*
- * free_computation()
- *
- *   Clean up a Needleman-Wunsch alignment computation.
+ * get_walk_directions()
  *
- *   C - the computation instance to clean up
+ *   Return the optimal directions out of the cell at (col, row) of a
+ *   scored computation: from its walk table if it keeps one, and
+ *   otherwise derived from its scores or checkpoints.
  */
-void
-free_computation(computation_t *C)
+walk_table_cell_t
+get_walk_directions(computation_t *C, int col, int row)
 {
-        int res = 1;
-
-        free_score_table(C->score_table, C->num_threads);
-        free_walk_table(C->walk_table, C->num_threads);
-
-        if (C->num_threads > 1) {
-                res = pthread_rwlock_destroy(&C->solution_count_rwlock);
-                check(0 == res, "pthread_rwlock_destroy failed");
+        if (NULL != C->walk_table) {
+                return *walk_table_cell(C->walk_table, col, row);
+        } else if (NULL != C->checkpoints) {
+                return checkpoint_walk_cell(C->checkpoints, col, row);
         }
-
-        free(C);
+        return derive_walk_cell(C, col, row);
 }
 
 /*
- * inc_solution_count()
+ * derive_walk_table()
  *
- *   Increment the solution count for the given computation.
+ *   Build the walk table of a computation scored without one, deriving
+ *   each stored cell's directions from the scores around it.  Only the
+ *   table printed by -t needs every cell's directions at once.
  *
- *   C - target computation
+ *   C - scored computation instance with linear gaps and no walk table
  */
 void
-inc_solution_count(computation_t *C)
+derive_walk_table(computation_t *C)
 {
-        if (C->num_threads > 1) {
-                pthread_rwlock_wrlock(&C->solution_count_rwlock);
-        }
+        score_table_t *S = C->score_table;
 
-        C->solution_count = C->solution_count + 1;
-
-        if (C->num_threads > 1) {
-                pthread_rwlock_unlock(&C->solution_count_rwlock);
+        debug("Deriving walk table from scores");
+        walk_table_t *W = alloc_walk_table(S->M, S->N, S->band,
+                                           C->num_threads);
+        for (int col = 0; col < S->M; col++) {
+                int last_row = score_table_last_row(S, col);
+                for (int row = score_table_first_row(S, col);
+                     row <= last_row; row++) {
+                        *walk_table_cell(W, col, row) =
+                                derive_walk_cell(C, col, row);
+                }
         }
+
+        C->walk_table = W;
 }
 
 /*
- * get_solution_count()
- *
- *   Return the solution count for the given computation.
+ * free_computation()
  *
- *   C - target computation
+ *   Clean up a Needleman-Wunsch alignment computation.
  *
- *   return - the computation's solution total
+ *   C - the computation instance to clean up
  */
-unsigned int
-get_solution_count(computation_t *C)
+void
+free_computation(computation_t *C)
 {
-        if (C->num_threads > 1) {
-                pthread_rwlock_rdlock(&C->solution_count_rwlock);
+        if (NULL != C->checkpoints) {
+                free_checkpoint_table(C->checkpoints);
+        } else {
+                free_score_table(C->score_table);
+        }
+        if (NULL != C->walk_table) {
+                free_walk_table(C->walk_table);
+        }
+        free(C->left_gap_scores);
+        free(C->up_gap_scores);
+        free(C->query_profile);
+        if (NULL != C->packed_side) {
+                free_packed_sequence(C->packed_side);
         }
-
-        unsigned int count = C->solution_count;
 
         if (C->num_threads > 1) {
-                pthread_rwlock_unlock(&C->solution_count_rwlock);
+                free_thread_pool(C->pool);
+                free_wavefront(C->wavefront);
         }
 
-        return count;
+        free(C);
 }
 
 /*
  * print_summary()
  *
  *   Print details about the algorithm's run to standard error.
- *   Specifically, print the number of optimal alignments and the
- *   optimal alignment score.
+ *   Specifically, print the number of optimal alignments, counted
+ *   without enumerating them (see path-count.c), the optimal
+ *   alignment score, the kernels that computed it, for a banded run,
+ *   whether an optimal alignment touches the edge of the band, for a
+ *   checkpointed run, how many columns it kept, and for an X-drop run,
+ *   how many cells it scored.
  *
  *   C - computation instance to summarize
  */
 void
 print_summary(computation_t *C)
 {
-        unsigned int soln_count = get_solution_count(C);
-        int max_col = C->score_table->M - 1;
-        int max_row = C->score_table->N - 1;
-        fprintf(stderr, "%d optimal alignment%s\n",
-               soln_count, (soln_count > 1 ? "s" : ""));
-        fprintf(stderr, "Optimal score is %-d\n",
-               C->score_table->cells[max_col][max_row].score);
+        char digits[PATH_COUNT_DIGITS];
+        path_count_t soln_count = count_alignments(C);
+        int max_col, max_row, score;
+        if (NULL != C->checkpoints) {
+                max_col = C->checkpoints->M - 1;
+                max_row = C->checkpoints->N - 1;
+                score = C->checkpoints->score;
+        } else {
+                max_col = C->score_table->M - 1;
+                max_row = C->score_table->N - 1;
+                score = score_table_get(C->score_table, max_col, max_row);
+        }
+        const kernel_set_t *K = get_kernels();
+        const param_kernel_t *P = find_param_kernel(K, C->match_score,
+                                                    C->mismatch_penalty,
+                                                    C->indel_penalty);
+        int specialized = NULL != P && C->score_column == P->score_column;
+        fprintf(stderr, "%s%s optimal alignment%s\n",
+                (soln_count == PATH_COUNT_MAX ? "At least " : ""),
+                format_path_count(soln_count, digits),
+                (soln_count > 1 ? "s" : ""));
+        fprintf(stderr, "Optimal score is %-d\n", score);
+        fprintf(stderr, "Scored with the %s kernels%s\n", K->name,
+                specialized ? " built for these operands" : "");
+        if (C->band >= 0 && C->touched_band_edge) {
+                fprintf(stderr, "An optimal alignment touches the edge of "
+                        "the band of width %d; a wider band may score "
+                        "higher\n", C->band);
+        } else if (C->band >= 0) {
+                fprintf(stderr, "No optimal alignment touches the edge of "
+                        "the band of width %d\n", C->band);
+        }
+        if (NULL != C->checkpoints) {
+                fprintf(stderr, "Kept %d of %d columns of scores as "
+                        "checkpoints\n",
+                        max_col / C->checkpoints->stride + 1, max_col + 1);
+        }
+        if (C->xdrop >= 0) {
+                fprintf(stderr, "X-drop of %d scored %zu of %zu cells\n",
+                        C->xdrop, C->cells_scored,
+                        (size_t)(max_col + 1) * (max_row + 1));
+        }
 }
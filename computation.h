@@ -38,8 +38,24 @@
 #ifndef __COMPUTATION_H__
 #define __COMPUTATION_H__
 
+#include "packed-sequence.h"
 #include "score-table.h"
+#include "substitution-matrix.h"
+#include "thread-pool.h"
 #include "walk-table.h"
+#include "wavefront.h"
+
+struct checkpoint_table;
+
+/* tables_t: What a computation keeps as it scores: the score and walk
+ *           tables; the score table alone, from which the directions
+ *           can be derived; or checkpointed columns of the score table
+ *           (see checkpoint.h) */
+typedef enum {
+        keep_walk_table,
+        keep_score_table,
+        keep_checkpoints
+} tables_t;
 
 /* Instance of a Needleman-Wunsch alignment computation */
 typedef struct computation {
@@ -47,31 +63,74 @@ typedef struct computation {
         char *top_string;
         char *side_string;
 
+        /* side_string packed two bits per base, which the column
+         * kernels read instead if it isn't NULL (see
+         * packed-sequence.h) */
+        packed_sequence_t *packed_side;
+
         /* Scoring parameters */
         int match_score;
         int mismatch_penalty;
         int indel_penalty;
 
-        /* Score table */
+        /* Penalty for each indel after the first in a run of them.
+         * With affine gaps (gap_extend_penalty != indel_penalty),
+         * indel_penalty is the cost of opening a gap. */
+        int gap_extend_penalty;
+
+        /* Substitution matrix scoring aligned characters in place of
+         * match_score and mismatch_penalty, or NULL, and the query
+         * profile of side_string built from it */
+        const substitution_matrix_t *matrix;
+        int *query_profile;
+
+        /* With affine gaps, the best score of an alignment ending in a
+         * left gap at the last scored cell of each row, and of one
+         * ending in an up gap at the last scored cell of each column.
+         * NULL with linear gaps. */
+        int *left_gap_scores;
+        int *up_gap_scores;
+
+        /* Score table, or NULL if the computation keeps checkpoints
+         * instead */
         score_table_t *score_table;
+        struct checkpoint_table *checkpoints;
+
+        /* Half-width of the band of cells scored (see -b), or -1 to
+         * score the whole table, and whether an optimal alignment
+         * passes next to a cell outside the band (set by the traceback,
+         * which may run on several threads) */
+        int band;
+        atomic_int touched_band_edge;
+
+        /* X-drop threshold (see -x), or -1 to score every cell, and the
+         * number of cells the X-drop sweep scored */
+        int xdrop;
+        size_t cells_scored;
 
         /* The walk_table maintains state during alignment
-         * reconstruction */
+         * reconstruction.  NULL if the directions are derived from the
+         * scores instead (see -a scores). */
         walk_table_t *walk_table;
 
-        /* We track the solution count for summarization purposes as
-         * well as for profiling the performance of our alignment
-         * reconstruction routine(s). */
-        unsigned int solution_count;
-        pthread_rwlock_t solution_count_rwlock;
-
         /* Number of threads to execute in parallel when writing scores
          * to score_table (defined above). */
         unsigned int num_threads;
 
-        /* A store for pointers to each of the worker threads we execute
-         * in parallel when writing scores to score_table. */
-        pthread_t *worker_threads;
+        /* Tile grid ordering the parallel fill of score_table.  NULL
+         * unless num_threads > 1. */
+        wavefront_t *wavefront;
+
+        /* Worker threads we execute in parallel when writing scores to
+         * score_table.  NULL unless num_threads > 1. */
+        thread_pool_t *pool;
+
+        /* Kernel writing scores to a run of cells in one column of
+         * score_table.  Chosen by compute_table_scores(). */
+        void (*score_column)(struct computation *C,
+                             int col,
+                             int first_row,
+                             int last_row);
 } computation_t;
 
 /*
@@ -83,7 +142,7 @@ computation_t *alloc_computation();
 void init_computation_tables(score_table_t *S,
                              walk_table_t *W,
                              int d,
-                             unsigned int nthreads);
+                             int e);
 
 computation_t *init_computation(computation_t *C,
                                 char *s1,
@@ -91,13 +150,18 @@ computation_t *init_computation(computation_t *C,
                                 int m,
                                 int k,
                                 int d,
-                                unsigned int nthreads);
+                                int e,
+                                const substitution_matrix_t *matrix,
+                                unsigned int nthreads,
+                                int band,
+                                int xdrop,
+                                tables_t tables);
 
-void free_computation(computation_t *C);
+walk_table_cell_t get_walk_directions(computation_t *C, int col, int row);
 
-void inc_solution_count(computation_t *C);
+void derive_walk_table(computation_t *C);
 
-unsigned int get_solution_count(computation_t *C);
+void free_computation(computation_t *C);
 
 void print_summary(computation_t *C);
 
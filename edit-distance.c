@@ -0,0 +1,218 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * edit-distance.c - Bit-parallel (Myers/Hyyro) edit distance engine, for
+ *                   scoring parameters under which the optimal alignment
+ *                   score is a function of the edit distance.
+ *
+ *                   One string (the pattern) runs down the rows of the
+ *                   edit distance table in blocks of 64; a block keeps
+ *                   the +1/-1 differences between vertically adjacent
+ *                   cells of the current column as two bit vectors, and
+ *                   a column of a block is advanced with a dozen word
+ *                   operations.  Horizontal differences carry between
+ *                   blocks from top to bottom.
+ *
+ *                   See Myers, "A fast bit-vector algorithm for
+ *                   approximate string matching based on dynamic
+ *                   programming", JACM 46(3), 1999, and Hyyro, "A
+ *                   bit-vector algorithm for computing Levenshtein and
+ *                   Damerau edit distances", NJC 10(1), 2003.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dbg.h"
+#include "edit-distance.h"
+
+#define WORD_BITS 64
+
+/* A block of 64 rows of one column: bit i of pv (mv) is set if the
+ * cell at row i is one more (less) than the cell above it */
+typedef struct block {
+        uint64_t pv;
+        uint64_t mv;
+} block_t;
+
+/*
+ * is_unit_cost()
+ *
+ *   Return nonzero if the scoring parameters make the optimal alignment
+ *   score a decreasing function of the edit distance.
+ *
+ *   An alignment of strings of lengths n1 and n2 with a matches, x
+ *   mismatches, and g indels has n1 + n2 = 2a + 2x + g, so it scores
+ *
+ *     m*a - k*x - d*g = m*(n1 + n2)/2 - (m + k)*x - (m/2 + d)*g.
+ *
+ *   That depends on x + g alone when m + k = m/2 + d, i.e. m + 2k = 2d,
+ *   and decreases with it when m + k > 0.
+ */
+int
+is_unit_cost(int m, int k, int d)
+{
+        return m + 2 * k == 2 * d && m + k > 0;
+}
+
+/*
+ * advance_block()
+ *
+ *   Advance block B by one column of the table, in which the pattern
+ *   characters of the block matching the text character are eq.  The
+ *   horizontal difference entering above the block's top row is +1 if
+ *   *hp is 1, -1 if *hn is 1, and 0 if both are 0; on return they hold
+ *   the difference at row last_bit of the block, which for every block
+ *   but the last is the one leaving its bottom row.
+ */
+static inline void
+advance_block(block_t *B, uint64_t eq, uint64_t *hp, uint64_t *hn,
+              int last_bit)
+{
+        uint64_t pv = B->pv;
+        uint64_t mv = B->mv;
+
+        uint64_t xv = eq | mv;
+        eq |= *hn;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+
+        uint64_t hp_out = (ph >> last_bit) & 1;
+        uint64_t hn_out = (mh >> last_bit) & 1;
+
+        ph = (ph << 1) | *hp;
+        mh = (mh << 1) | *hn;
+        B->pv = mh | ~(xv | ph);
+        B->mv = ph & xv;
+
+        *hp = hp_out;
+        *hn = hn_out;
+}
+
+/*
+ * edit_distance()
+ *
+ *   Return the Levenshtein distance between a and b.
+ */
+int
+edit_distance(const char *a, const char *b)
+{
+        const char *pattern = a;
+        const char *text = b;
+        int rows = strlen(a);
+        int cols = strlen(b);
+
+        /* The pattern is the shorter string, so it needs fewer blocks */
+        if (cols < rows) {
+                pattern = b;
+                text = a;
+                int t = rows;
+                rows = cols;
+                cols = t;
+        }
+        if (rows == 0) {
+                return cols;
+        }
+
+        int nblocks = (rows + WORD_BITS - 1) / WORD_BITS;
+        int last_bit = (rows - 1) % WORD_BITS;
+
+        /* Match masks: row peq_index[c] of peq has bit i of block j set
+           if pattern character 64j + i is c.  Row 0 matches nothing,
+           for text characters absent from the pattern. */
+        int peq_index[256] = { 0 };
+        int nchars = 1;
+        for (int i = 0; i < rows; i++) {
+                unsigned char c = pattern[i];
+                if (peq_index[c] == 0) {
+                        peq_index[c] = nchars++;
+                }
+        }
+        uint64_t *peq = calloc((size_t)nchars * nblocks, sizeof(uint64_t));
+        check(NULL != peq, "calloc failed");
+        for (int i = 0; i < rows; i++) {
+                unsigned char c = pattern[i];
+                peq[(size_t)peq_index[c] * nblocks + i / WORD_BITS] |=
+                        (uint64_t)1 << (i % WORD_BITS);
+        }
+
+        /* The left column counts up one per row */
+        block_t *blocks = malloc(nblocks * sizeof(block_t));
+        check(NULL != blocks, "malloc failed");
+        for (int b = 0; b < nblocks; b++) {
+                blocks[b].pv = ~(uint64_t)0;
+                blocks[b].mv = 0;
+        }
+
+        /* The bottom-right cell, tracked along the bottom row, which
+           starts at the bottom of the left column */
+        int distance = rows;
+
+        for (int j = 0; j < cols; j++) {
+                const uint64_t *eq =
+                        &peq[(size_t)peq_index[(unsigned char)text[j]] *
+                             nblocks];
+
+                /* The top row counts up one per column */
+                uint64_t hp = 1;
+                uint64_t hn = 0;
+                for (int b = 0; b < nblocks - 1; b++) {
+                        advance_block(&blocks[b], eq[b], &hp, &hn,
+                                      WORD_BITS - 1);
+                }
+                advance_block(&blocks[nblocks-1], eq[nblocks-1], &hp, &hn,
+                              last_bit);
+                distance += (int)hp - (int)hn;
+        }
+
+        free(peq);
+        free(blocks);
+
+        return distance;
+}
+
+/*
+ * unit_cost_score()
+ *
+ *   Return the optimal alignment score of top and side under a match
+ *   bonus m and indel penalty d.  The mismatch penalty must be the one
+ *   that makes is_unit_cost() hold.
+ */
+int
+unit_cost_score(const char *top, const char *side, int m, int d)
+{
+        long long n = (long long)strlen(top) + strlen(side);
+        return (m / 2) * n - (m / 2 + d) * (long long)edit_distance(top, side);
+}
@@ -46,35 +46,46 @@
  */
 void
 set_fmt(fmt_t f)
+{
+        fset_fmt(stdout, f);
+}
+
+/*
+ * fset_fmt()
+ *
+ *   Like set_fmt(), but for the output stream out.
+ */
+void
+fset_fmt(FILE *out, fmt_t f)
 {
         if (cflag == 1) {
                 switch (f) {
                 case top_string_fmt:
-                        printf(TOP_STRING_FMT);
+                        fprintf(out, TOP_STRING_FMT);
                         break;
                 case side_string_fmt:
-                        printf(SIDE_STRING_FMT);
+                        fprintf(out, SIDE_STRING_FMT);
                         break;
                 case opt_path_fmt:
-                        printf(OPT_PATH_FMT);
+                        fprintf(out, OPT_PATH_FMT);
                         break;
                 case match_arrow_fmt:
-                        printf(MATCH_ARROW_FMT);
+                        fprintf(out, MATCH_ARROW_FMT);
                         break;
                 case mismatch_arrow_fmt:
-                        printf(MISMATCH_ARROW_FMT);
+                        fprintf(out, MISMATCH_ARROW_FMT);
                         break;
                 case gap_arrow_fmt:
-                        printf(GAP_ARROW_FMT);
+                        fprintf(out, GAP_ARROW_FMT);
                         break;
                 case match_char_fmt:
-                        printf(MATCH_CHAR_FMT);
+                        fprintf(out, MATCH_CHAR_FMT);
                         break;
                 case mismatch_char_fmt:
-                        printf(MISMATCH_CHAR_FMT);
+                        fprintf(out, MISMATCH_CHAR_FMT);
                         break;
                 case gap_char_fmt:
-                        printf(GAP_CHAR_FMT);
+                        fprintf(out, GAP_CHAR_FMT);
                         break;
                 default:
                         unreachable();
@@ -90,8 +101,19 @@ set_fmt(fmt_t f)
  *   the standard output.
  */
 void reset_fmt()
+{
+        freset_fmt(stdout);
+}
+
+/*
+ * freset_fmt()
+ *
+ *   Like reset_fmt(), but for the output stream out.
+ */
+void
+freset_fmt(FILE *out)
 {
         if (cflag == 1) {
-                printf(RESET_FMT);
+                fprintf(out, RESET_FMT);
         }
 }
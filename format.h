@@ -39,6 +39,8 @@
 #ifndef __FORMAT_H__
 #define __FORMAT_H__
 
+#include <stdio.h>
+
 /* ASCII 27 is the ESC to start CSI formatting in the ANSI terminal
  * standard*/
 #define ANSI_CSI_OPEN   "\x1b["
@@ -129,6 +131,10 @@ typedef enum {
 
 void set_fmt(fmt_t f);
 
+void fset_fmt(FILE *out, fmt_t f);
+
 void reset_fmt();
 
+void freset_fmt(FILE *out);
+
 #endif /* __FORMAT_H__ */
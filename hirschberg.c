@@ -0,0 +1,326 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * hirschberg.c - Hirschberg's divide-and-conquer alignment, which finds
+ *                one optimal alignment in space linear in the lengths of
+ *                the input strings.
+ *
+ *                We cut the top string in half.  Scoring the left half
+ *                forwards and the right half backwards, one column at a
+ *                time, gives the best score of every way the halves'
+ *                alignments could meet at the cut; the best row to
+ *                cross the cut at splits the problem in two, and we
+ *                recurse on each part.  Small parts are aligned with an
+ *                ordinary score table.  Every column is scored with the
+ *                column sweeps of score-kernel.c, so the scoring rules
+ *                are those of score_two_columns(); the backward sweep
+ *                runs over reversed copies of the strings.
+ *
+ *                See Hirschberg, "A linear space algorithm for computing
+ *                maximal common subsequences", CACM 18(6), 1975.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dbg.h"
+#include "hirschberg.h"
+#include "score-kernel.h"
+
+#define GAP_CHAR '-'
+
+/* Parts with at most this many cells are aligned with a score table */
+#define HIRSCHBERG_BASE_CELLS 4096
+
+/* State shared by every step of one alignment */
+struct hirschberg {
+        const char *top;
+        const char *side;
+        int top_len;
+        int side_len;
+        int d;
+
+        /* The strings reversed, and sweeps over side and over it
+           reversed */
+        char *rtop;
+        char *rside;
+        column_sweep_t forward;
+        column_sweep_t backward;
+
+        /* Aligned strings, built from left to right, and their length */
+        char *X;
+        char *Y;
+        int n;
+
+        /* Columns of scores for the forward and backward sweeps, and
+           one more for the column being scored */
+        int *fwd;
+        int *bwd;
+        int *tmp;
+};
+
+/*
+ * last_column()
+ *
+ *   Score the top characters [top_first, top_last) against the side
+ *   characters [side_first, side_last), one column at a time, and leave
+ *   the last column in col.  If reverse is nonzero, both strings are
+ *   read from the end, so col[r] scores the last r side characters
+ *   against all of the top ones.
+ */
+static void
+last_column(struct hirschberg *H,
+            int top_first,
+            int top_last,
+            int side_first,
+            int side_last,
+            int reverse,
+            int *col)
+{
+        const column_sweep_t *W = reverse ? &H->backward : &H->forward;
+        const char *top = reverse ? H->rtop + H->top_len - top_last
+                                  : H->top + top_first;
+        int first = reverse ? H->side_len - side_last : side_first;
+        int rows = side_last - side_first;
+
+        int *prev = col;
+        int *this = H->tmp;
+        for (int r = 0; r <= rows; r++) {
+                prev[r] = -r * H->d;
+        }
+
+        for (int c = 0; c < top_last - top_first; c++) {
+                score_sweep_column(W, top[c], c + 1, first, rows, prev, this);
+                int *swap = prev;
+                prev = this;
+                this = swap;
+        }
+
+        if (prev != col) {
+                memcpy(col, prev, (rows + 1) * sizeof(int));
+        }
+}
+
+/*
+ * append()
+ *
+ *   Append the column (x, y) to the alignment.  Columns are appended
+ *   from the right end of the alignment to the left.
+ */
+static inline void
+append(struct hirschberg *H, char x, char y)
+{
+        H->X[H->n] = x;
+        H->Y[H->n] = y;
+        H->n++;
+}
+
+/*
+ * align_small()
+ *
+ *   Align the top characters [top_first, top_last) with the side
+ *   characters [side_first, side_last) using a score table.  Only used
+ *   when the table is small or one of the strings is at most one
+ *   character long, so the table stays linear in size.  On ties we
+ *   prefer the diagonal, then left, then up, as the full-table walk
+ *   does.
+ *
+ *   return - the score of the alignment
+ */
+static int
+align_small(struct hirschberg *H,
+            int top_first,
+            int top_last,
+            int side_first,
+            int side_last)
+{
+        int cols = top_last - top_first + 1;
+        int rows = side_last - side_first + 1;
+        int *S = malloc((size_t)cols * rows * sizeof(int));
+        check(NULL != S, "malloc failed");
+
+        for (int r = 0; r < rows; r++) {
+                S[r] = -r * H->d;
+        }
+        for (int c = 1; c < cols; c++) {
+                score_sweep_column(&H->forward, H->top[top_first + c - 1],
+                                   c, side_first, rows - 1,
+                                   &S[(c-1)*rows], &S[c*rows]);
+        }
+
+        /* Walk back from the bottom-right corner */
+        int c = cols - 1;
+        int r = rows - 1;
+        int score = S[c*rows + r];
+        while (c > 0 || r > 0) {
+                int here = S[c*rows + r];
+                char t = c > 0 ? H->top[top_first + c - 1] : GAP_CHAR;
+                char s = r > 0 ? H->side[side_first + r - 1] : GAP_CHAR;
+                if (c > 0 && r > 0 &&
+                    here == S[(c-1)*rows + r-1] +
+                    column_sweep_bonus(&H->forward, t,
+                                       side_first + r - 1)) {
+                        append(H, t, s);
+                        c--;
+                        r--;
+                } else if (c > 0 && here == S[(c-1)*rows + r] - H->d) {
+                        append(H, t, GAP_CHAR);
+                        c--;
+                } else {
+                        append(H, GAP_CHAR, s);
+                        r--;
+                }
+        }
+
+        free(S);
+        return score;
+}
+
+/*
+ * align_part()
+ *
+ *   Append an optimal alignment of the top characters [top_first,
+ *   top_last) with the side characters [side_first, side_last).
+ *
+ *   return - the score of the alignment, the best sum of the sweeps
+ *            at the cut
+ */
+static int
+align_part(struct hirschberg *H,
+           int top_first,
+           int top_last,
+           int side_first,
+           int side_last)
+{
+        int cols = top_last - top_first;
+        int rows = side_last - side_first;
+
+        if (cols <= 1 || rows <= 1 ||
+            (long long)(cols + 1) * (rows + 1) <= HIRSCHBERG_BASE_CELLS) {
+                return align_small(H, top_first, top_last, side_first,
+                                   side_last);
+        }
+
+        /* Score the left half of the top string forwards and the right
+           half backwards, and cross the cut where they sum highest */
+        int mid = top_first + cols / 2;
+        last_column(H, top_first, mid, side_first, side_last, 0, H->fwd);
+        last_column(H, mid, top_last, side_first, side_last, 1, H->bwd);
+
+        int cut = 0;
+        int best = H->fwd[0] + H->bwd[rows];
+        for (int r = 1; r <= rows; r++) {
+                if (H->fwd[r] + H->bwd[rows - r] > best) {
+                        best = H->fwd[r] + H->bwd[rows - r];
+                        cut = r;
+                }
+        }
+
+        /* Right part first: the alignment is built from right to left */
+        align_part(H, mid, top_last, side_first + cut, side_last);
+        align_part(H, top_first, mid, side_first, side_first + cut);
+        return best;
+}
+
+/*
+ * hirschberg_align()
+ *
+ *   Find one optimal alignment of top and side, scoring with match
+ *   bonus m, mismatch penalty k, and indel penalty d, or with the
+ *   substitution matrix in place of m and k if it isn't NULL.
+ *
+ *   X, Y - buffers of at least strlen(top) + strlen(side) characters,
+ *          which receive the aligned top and side strings.  As in
+ *          construct_alignments(), they are written backwards: X[0] and
+ *          Y[0] are the last column of the alignment.
+ *
+ *   score - where to store the optimal score
+ *
+ *   return - length of the alignment
+ */
+int
+hirschberg_align(const char *top,
+                 const char *side,
+                 int m,
+                 int k,
+                 int d,
+                 const substitution_matrix_t *matrix,
+                 char *X,
+                 char *Y,
+                 int *score)
+{
+        int top_len = strlen(top);
+        int side_len = strlen(side);
+
+        struct hirschberg H = {
+                .top = top,
+                .side = side,
+                .top_len = top_len,
+                .side_len = side_len,
+                .d = d,
+                .X = X,
+                .Y = Y,
+                .n = 0,
+        };
+        H.rtop = malloc(top_len + 1);
+        H.rside = malloc(side_len + 1);
+        check(NULL != H.rtop && NULL != H.rside, "malloc failed");
+        for (int i = 0; i < top_len; i++) {
+                H.rtop[i] = top[top_len - 1 - i];
+        }
+        for (int i = 0; i < side_len; i++) {
+                H.rside[i] = side[side_len - 1 - i];
+        }
+        H.rtop[top_len] = '\0';
+        H.rside[side_len] = '\0';
+        init_column_sweep(&H.forward, side, m, k, d, matrix);
+        init_column_sweep(&H.backward, H.rside, m, k, d, matrix);
+
+        H.fwd = malloc((side_len + 1) * sizeof(int));
+        H.bwd = malloc((side_len + 1) * sizeof(int));
+        H.tmp = malloc((side_len + 1) * sizeof(int));
+        check(NULL != H.fwd && NULL != H.bwd && NULL != H.tmp,
+              "malloc failed");
+
+        *score = align_part(&H, 0, top_len, 0, side_len);
+
+        free(H.fwd);
+        free(H.bwd);
+        free(H.tmp);
+        free_column_sweep(&H.forward);
+        free_column_sweep(&H.backward);
+        free(H.rtop);
+        free(H.rside);
+
+        return H.n;
+}
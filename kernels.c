@@ -0,0 +1,201 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * kernels.c - Runtime selection of the scoring kernels.  The SIMD
+ *             kernels are compiled once per instruction set; at startup
+ *             we ask the CPU which sets it supports and run the widest.
+ */
+
+#include <string.h>
+
+#include "dbg.h"
+#include "kernels.h"
+#include "score-kernel.h"
+#include "striped.h"
+
+static int
+cpu_any(void)
+{
+        return 1;
+}
+
+#ifdef HAVE_X86_KERNELS
+static int
+cpu_sse41(void)
+{
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.1");
+}
+
+static int
+cpu_avx2(void)
+{
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+}
+
+static int
+cpu_avx512(void)
+{
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512f") &&
+                __builtin_cpu_supports("avx512bw");
+}
+#endif /* HAVE_X86_KERNELS */
+
+/* Every kernel set built into the program, widest first */
+static const kernel_set_t kernel_sets[] = {
+#ifdef HAVE_X86_KERNELS
+        { "avx512", cpu_avx512, score_cell_column_avx512,
+          score_cell_column_profile_avx512,
+          score_cell_column_affine_avx512,
+          score_cell_column_affine_profile_avx512,
+          param_kernels_avx512, striped_score_avx512 },
+        { "avx2", cpu_avx2, score_cell_column_avx2,
+          score_cell_column_profile_avx2,
+          score_cell_column_affine_avx2,
+          score_cell_column_affine_profile_avx2,
+          param_kernels_avx2, striped_score_avx2 },
+        { "sse4.1", cpu_sse41, score_cell_column_sse41,
+          score_cell_column_profile_sse41,
+          score_cell_column_affine_sse41,
+          score_cell_column_affine_profile_sse41,
+          param_kernels_sse41, striped_score_sse41 },
+#endif
+        { "generic", cpu_any, score_cell_column,
+          score_cell_column_profile,
+          score_cell_column_affine,
+          score_cell_column_affine_profile,
+          param_kernels_generic, NULL },
+};
+
+#define NUM_KERNEL_SETS (sizeof(kernel_sets) / sizeof(kernel_sets[0]))
+
+/* The kernel set in use, once chosen */
+static const kernel_set_t *selected = NULL;
+
+/*
+ * select_kernels()
+ *
+ *   Choose the kernel set used for the rest of the run.
+ *
+ *   name - name of the kernel set to use, or NULL to use the widest
+ *          set the running CPU supports
+ *
+ *   return - the chosen kernel set
+ */
+const kernel_set_t *
+select_kernels(const char *name)
+{
+        const kernel_set_t *K = NULL;
+
+        if (NULL == name) {
+                /* The generic set is last and always supported */
+                K = &kernel_sets[0];
+                while (!K->supported()) {
+                        K++;
+                }
+        } else {
+                for (size_t i = 0; i < NUM_KERNEL_SETS; i++) {
+                        if (strcmp(name, kernel_sets[i].name) == 0) {
+                                K = &kernel_sets[i];
+                        }
+                }
+                check(NULL != K, "unknown instruction set %s", name);
+                check(K->supported(), "this CPU does not support %s", name);
+        }
+
+        debug("Selected the %s kernels", K->name);
+        selected = K;
+        return K;
+}
+
+/*
+ * get_kernels()
+ *
+ *   Return the kernel set in use, choosing the widest set the running
+ *   CPU supports if select_kernels() hasn't been called.
+ */
+const kernel_set_t *
+get_kernels(void)
+{
+        if (NULL == selected) {
+                return select_kernels(NULL);
+        }
+        return selected;
+}
+
+/*
+ * find_param_kernel()
+ *
+ *   Return the column kernel of kernel set K built for match bonus m,
+ *   mismatch penalty k, and indel penalty d, or NULL if PARAMS didn't
+ *   list them.
+ */
+const param_kernel_t *
+find_param_kernel(const kernel_set_t *K, int m, int k, int d)
+{
+        for (const param_kernel_t *P = K->param_kernels;
+             NULL != P->score_column; P++) {
+                if (P->match_score == m &&
+                    P->mismatch_penalty == k &&
+                    P->indel_penalty == d) {
+                        return P;
+                }
+        }
+        return NULL;
+}
+
+/*
+ * choose_column_kernel()
+ *
+ *   Return the column kernel of kernel set K that scores computation C:
+ *   its kernel built for C's scoring parameters if PARAMS listed them,
+ *   its kernel for affine gaps or a substitution matrix if C needs one,
+ *   or its generic column kernel.
+ */
+score_column_fn
+choose_column_kernel(const kernel_set_t *K, const computation_t *C)
+{
+        if (C->gap_extend_penalty != C->indel_penalty) {
+                return NULL != C->matrix ? K->score_column_affine_profile :
+                        K->score_column_affine;
+        } else if (NULL != C->matrix) {
+                return K->score_column_profile;
+        }
+
+        const param_kernel_t *P = find_param_kernel(K, C->match_score,
+                                                    C->mismatch_penalty,
+                                                    C->indel_penalty);
+        return NULL != P ? P->score_column : K->score_column;
+}
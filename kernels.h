@@ -0,0 +1,93 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * kernels.h - Definition of the sets of scoring kernels the program can
+ *             run, one per instruction set, and prototypes for the
+ *             functions in kernels.c that pick one for the running CPU.
+ */
+
+#ifndef __KERNELS_H__
+#define __KERNELS_H__
+
+#include "computation.h"
+#include "score-kernel.h"
+
+/* kernel_set_t: The scoring kernels built for one instruction set */
+typedef struct kernel_set {
+        /* Name accepted by -i and reported by -s */
+        const char *name;
+
+        /* Return nonzero if the running CPU can execute this set */
+        int (*supported)(void);
+
+        /* Column kernel for the score table (see score-kernel.h) */
+        score_column_fn score_column;
+
+        /* Column kernel scoring with a substitution matrix */
+        score_column_fn score_column_profile;
+
+        /* Column kernels for affine gaps, without and with a
+         * substitution matrix */
+        score_column_fn score_column_affine;
+        score_column_fn score_column_affine_profile;
+
+        /* Column kernels specialized for the parameter sets in PARAMS */
+        const param_kernel_t *param_kernels;
+
+        /* Score-only engine (see striped.h), or NULL if this set has
+         * none and score-only runs use score_two_columns() instead */
+        int (*score_only)(const char *top,
+                          const char *side,
+                          int m,
+                          int k,
+                          int d,
+                          const substitution_matrix_t *matrix);
+} kernel_set_t;
+
+/*
+ * Prototypes
+ */
+
+const kernel_set_t *select_kernels(const char *name);
+
+const kernel_set_t *get_kernels(void);
+
+const param_kernel_t *find_param_kernel(const kernel_set_t *K,
+                                        int m,
+                                        int k,
+                                        int d);
+
+score_column_fn choose_column_kernel(const kernel_set_t *K,
+                                     const computation_t *C);
+
+#endif /* __KERNELS_H__ */
@@ -38,23 +38,32 @@
 
 #include <math.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "checkpoint.h"
 #include "computation.h"
 #include "dbg.h"
+#include "edit-distance.h"
 #include "format.h"
+#include "hirschberg.h"
+#include "kernels.h"
 #include "needleman-wunsch.h"
+#include "path-count.h"
 #include "print-table.h"
 #include "read-sequences.h"
+#include "score-kernel.h"
 #include "score-table.h"
 #include "walk-table.h"
 
 #define GAP_CHAR '-'
 
-#define NUM_OPERANDS 3
+#define MIN_OPERANDS 3
+#define MAX_OPERANDS 4
 
 /* ANSI terminal output formatting flag (defined in format.h) */
 extern int cflag;
@@ -66,62 +75,92 @@ void
 usage()
 {
         fprintf(stderr, "\
-usage: needleman-wunsch [-c][-h][-l][-q][-s][-t][-u]\n\
-                        [-p num-threads] [-f sequence-file] m k d\n\
+usage: needleman-wunsch [-c][-h][-l][-o][-q][-s][-t][-u] [-a algorithm]\n\
+                        [-b width] [-i isa] [-k max-alignments]\n\
+                        [-n count] [-p num-threads] [-r seed] [-x X]\n\
+                        [-M matrix-file] [-f sequence-file] m k d [e]\n\
 Align two sequences with the Needleman-Wunsch algorithm\n\
 operands:\n\
-   m   match bonus\n\
-   k   mismatch penalty\n\
-   d   indel (gap) penalty\n\
+   m   match bonus (left out with -M)\n\
+   k   mismatch penalty (left out with -M)\n\
+   d   indel (gap) penalty; with e, the penalty for opening a gap\n\
+   e   penalty for extending a gap (affine gaps; defaults to d)\n\
 options:\n\
+  -a algorithm\n\
+       construct alignments with 'algorithm': 'table' (the default) finds\n\
+       every optimal alignment; 'scores' does too, without a walk table;\n\
+       'checkpoint' does too, keeping only some columns of scores;\n\
+       'hirschberg' finds one, in linear space\n\
+  -b width\n\
+       score only the cells at most 'width' diagonals off the main one\n\
   -c   color the output with ANSI escape sequences\n\
   -f sequence-file\n\
        read the input strings from 'sequence-file' instead of standard input\n\
   -h   print this usage message\n\
+  -i isa\n\
+       score with the kernels for instruction set 'isa' (avx512, avx2,\n\
+       sse4.1, or generic) instead of the best one this CPU supports\n\
+  -k max-alignments\n\
+       stop after printing 'max-alignments' optimal alignments\n\
   -l   list match, mismatch, and indel counts for each alignment pair\n\
+  -M matrix-file\n\
+       score aligned characters with the substitution matrix in\n\
+       'matrix-file', in NCBI format (e.g. BLOSUM62), instead of m and k\n\
+  -n count\n\
+       print 'count' optimal alignments drawn uniformly at random (with\n\
+       replacement) instead of every optimal alignment\n\
+  -o   print only the optimal score; no alignments are constructed\n\
   -p num-threads\n\
        parallelize the computation with 'num-threads' threads (must be >1)\n\
   -q   be quiet and don't print the aligned strings\n\
+  -r seed\n\
+       seed the random draws of -n with 'seed' instead of the time\n\
   -s   summarize the algorithm's run\n\
   -t   print the scores table; only useful for shorter input strings\n\
-  -u   use unicode arrows when printing the scores table\n");
+  -u   use unicode arrows when printing the scores table\n\
+  -x X\n\
+       stop scoring a path once it falls more than X below the best score\n");
         exit(1);
 }
 
 /*
  * print_aligned_string_char()
  *
- *   Print the character s1[n] formatted according to its relationship
- *   to s2[n].  Depending on whether the two match, mismatch, or are gap
- *   characters, set the output formatting accordingly.
+ *   Print the character s1[n] to out formatted according to its
+ *   relationship to s2[n].  Depending on whether the two match,
+ *   mismatch, or are gap characters, set the output formatting
+ *   accordingly.
  *
  *   See format.h for definitions of the formats referenced in the
  *   function.
  */
 void
-print_aligned_string_char(char *s1, char *s2, int n)
+print_aligned_string_char(FILE *out, char *s1, char *s2, int n)
 {
         /* Format the output character as defined in format.h */
         if (s1[n] == s2[n]) {
-                set_fmt(match_char_fmt);
+                fset_fmt(out, match_char_fmt);
         } else if (s1[n] == GAP_CHAR || s2[n] == GAP_CHAR) {
-                set_fmt(gap_char_fmt);
+                fset_fmt(out, gap_char_fmt);
         } else if (s1[n] != s2[n]) {
-                set_fmt(mismatch_char_fmt);
+                fset_fmt(out, mismatch_char_fmt);
         } else {
                 unreachable();
         }
 
-        /* Print the character */
-        printf("%c", s1[n]);
+        /* Print the character.  The caller holds the stream's lock. */
+        putc_unlocked(s1[n], out);
 
-        reset_fmt();
+        freset_fmt(out);
 }
 
 /*
  * print_aligned_strings_and_counts()
  *
- *   Print the aligned sequences X and Y unless no_print_strings is 1.
+ *   Print the aligned sequences X and Y to out unless
+ *   no_print_strings is 1.
+ *
+ *   out - Stream to print to
  *
  *   X - Aligned form of the top string to print
  *
@@ -135,7 +174,8 @@ print_aligned_string_char(char *s1, char *s2, int n)
  *                  for this pair of aligned sequences
  */
 void
-print_aligned_strings_and_counts(char *X,
+print_aligned_strings_and_counts(FILE *out,
+                                 char *X,
                                  char *Y,
                                  int n,
                                  int no_print_strings,
@@ -145,10 +185,14 @@ print_aligned_strings_and_counts(char *X,
         int mismatch_count = 0;
         int gap_count = 0;
 
+        /* Take the stream's lock once rather than for every
+           character */
+        flockfile(out);
+
         /* Print the strings backwards */
         for (int i = n; i > -1; i--) {
                 if (no_print_strings != 1) {
-                        print_aligned_string_char(X, Y, i);
+                        print_aligned_string_char(out, X, Y, i);
                 }
                 if (print_counts == 1) {
                         if (X[i] == Y[i]) {
@@ -162,23 +206,84 @@ print_aligned_strings_and_counts(char *X,
         }
 
         if (0 == no_print_strings) {
-                printf("\n");
+                fprintf(out, "\n");
 
                 for (int i = n; i > -1; i--) {
-                        print_aligned_string_char(Y, X, i);
+                        print_aligned_string_char(out, Y, X, i);
                 }
-                printf("\n");
+                fprintf(out, "\n");
         }
 
         /* Print match/mismatch/gap counts if lflag was set */
         if (print_counts == 1) {
-                printf("%d match%s, %d mismatch%s, %d indel%s\n",
-                       match_count, (match_count == 1 ? "" : "es"),
-                       mismatch_count, (mismatch_count == 1 ? "" : "es"),
-                       gap_count, (gap_count == 1 ? "" : "s"));
+                fprintf(out, "%d match%s, %d mismatch%s, %d indel%s\n",
+                        match_count, (match_count == 1 ? "" : "es"),
+                        mismatch_count, (mismatch_count == 1 ? "" : "es"),
+                        gap_count, (gap_count == 1 ? "" : "s"));
         }
 
-        printf("\n");
+        fprintf(out, "\n");
+
+        funlockfile(out);
+}
+
+/* A step of the walk in construct_alignments_for_subtable(): the cell,
+   its optimal directions, and the next move out of it to try */
+struct walk_step {
+        int col;
+        int row;
+        walk_table_cell_t dirs;
+        int next_move;
+};
+
+/* A piece of the traceback for a worker thread: the alignments that
+   leave cell (start_i, start_j) after the start_n columns already in X
+   and Y, up to max of them if max is not 0.  Only the earliest piece
+   not yet printed, the one at_head, prints to the standard output;
+   the others print into text until they get there. */
+struct walk_table_args {
+        computation_t *C;
+        char *X;
+        char *Y;
+        int start_i;
+        int start_j;
+        int start_n;
+        int max;
+        FILE *stream;
+        char *text;
+        size_t size;
+        atomic_int at_head;
+        int done;
+};
+
+/*
+ * piece_stream()
+ *
+ *   Return the stream a traceback piece prints its next alignment to.
+ *   Once the piece is at the head of the output, it prints what it
+ *   has held back and from then on prints to the standard output.
+ */
+static FILE *
+piece_stream(struct walk_table_args *T)
+{
+        if (T->stream == stdout) {
+                return stdout;
+        }
+        if (atomic_load(&T->at_head)) {
+                if (NULL != T->stream) {
+                        fclose(T->stream);
+                        fwrite(T->text, 1, T->size, stdout);
+                        free(T->text);
+                        T->text = NULL;
+                }
+                T->stream = stdout;
+                return stdout;
+        }
+        if (NULL == T->stream) {
+                T->stream = open_memstream(&T->text, &T->size);
+                check(NULL != T->stream, "open_memstream failed");
+        }
+        return T->stream;
 }
 
 /*
@@ -188,7 +293,14 @@ print_aligned_strings_and_counts(char *X,
  *   computation's walk_table and reconstruct all optimal alignments of
  *   the input strings.  The cell (start_i, start_j) forms the
  *   bottom-righthand boundary of the subtable this call will construct
- *   solutions for.
+ *   solutions for.  If the computation keeps no walk table, each
+ *   cell's directions are derived from the scores as the walk enters
+ *   it, rescoring the cell's strip first if the computation keeps
+ *   checkpoints.
+ *
+ *   Out of each cell the walk tries diag, then left, then up, so the
+ *   alignments come out in the same order on every run.  If max is not
+ *   0, the walk stops once it has constructed that many.
  *
  *   C - computation instance to reconstruct alignments for
  *
@@ -205,139 +317,782 @@ print_aligned_strings_and_counts(char *X,
  *             for
  *
  *   start_n - starting offset in the alignment string buffers (X & Y)
+ *
+ *   piece - the piece of a parallel walk this walk is, or NULL to
+ *           print straight to the standard output
+ *
+ *   max - number of alignments to stop after, or 0 for all of them
+ *
+ *   Returns the number of alignments constructed.
  */
-void
+int
 construct_alignments_for_subtable(computation_t *C,
                                   char *X,
                                   char *Y,
                                   int start_i,
                                   int start_j,
-                                  int start_n)
+                                  int start_n,
+                                  struct walk_table_args *piece,
+                                  int max)
 {
         /* We move through the walk table starting at the bottom-right
          * corner as defined by start_i (the righthand limit for this
          * table walk) and start_j (the lower limit for this table
          * walk). */
         walk_table_t *W = C->walk_table;
-        int i = start_i;  /* position (x direction) */
-        int j = start_j;  /* position (y direction) */
-        int n = start_n;  /* character count */
+
+        /* We do the walk iteratively because we'll overrun the stack on
+         * a sufficiently large input.  Every move emits a column of the
+         * alignment, so the walk is at most start_i + start_j moves
+         * deep, and the alignment built so far is as long as the walk
+         * is deep. */
+        size_t max_depth = (size_t)start_i + start_j + 1;
+        struct walk_step *stack =
+                (struct walk_step *)malloc(max_depth *
+                                           sizeof(struct walk_step));
+        check(NULL != stack, "malloc failed");
 
         debug("Starting alignment construction.");
 
-        /* We do the walk iteratively because we'll overrun the stack on
-         * a sufficiently large input.  Yes, it is ugly, but it is
-         * necessary if we want to handle arbitrarily large inputs. */
-        while (!(i == start_i &&
-                 j == start_j &&
-                 1 == W->cells[i][j].up_done &&
-                 1 == W->cells[i][j].diag_done &&
-                 1 == W->cells[i][j].left_done)) {
-
-                /* We've visited the cell, so mark it as part of the
-                 * optimal path */
-                if (tflag == 1) {
-                        W->cells[i][j].in_optimal_path = 1;
-                }
-
-                /*
-                 *  Special Case: We've reached the top-left corner of
-                 *                the table, so we print the current
-                 *                solution (i.e. aligned strings X & Y)
-                 *                to the standard output.
-                 */
-                if (i == 0 && j == 0) {
-                        if (qflag != 1 || lflag == 1) {
-                                print_aligned_strings_and_counts(X, Y, n-1,
-                                                                 qflag, lflag);
+        stack[0] = (struct walk_step){start_i, start_j, 0, 0};
+        int depth = 1;
+        int constructed = 0;
+
+        while (depth > 0) {
+                struct walk_step *step = &stack[depth-1];
+                int i = step->col;
+                int j = step->row;
+                int n = start_n + depth - 1;
+
+                if (step->next_move == 0) {
+                        /* We've entered the cell, so look up its
+                         * directions and mark it as part of the optimal
+                         * path */
+                        if (NULL != W && tflag == 1) {
+                                *walk_table_cell(W, i, j) |= walk_optimal;
                         }
-                        inc_solution_count(C);
-                }
-
-                /*
-                 * Base Case: All cells adjacent (up/diag/left) to the
-                 *            current cell have been marked "done," so
-                 *            we return to the cell we were last in via
-                 *            the 'src_direction' indicator.
-                 */
-                if (W->cells[i][j].up_done &&
-                    W->cells[i][j].diag_done &&
-                    W->cells[i][j].left_done) {
-                        /* Mark all possible paths as "not done" for
-                           future visits */
-                        W->cells[i][j].up_done   = (W->cells[i][j].up ? 0 : 1);
-                        W->cells[i][j].diag_done = (W->cells[i][j].diag ? 0 : 1);
-                        W->cells[i][j].left_done = (W->cells[i][j].left ? 0 : 1);
-
-                        /* Change i and j so we are "back in the source
-                           cell."  Mark the source cell's relevant
-                           direction "done" */
-                        switch(W->cells[i][j].src_direction) {
-                        case up:
-                                j = j + 1;
-                                W->cells[i][j].up_done = 1;
-                                break;
-                        case left:
-                                i = i + 1;
-                                W->cells[i][j].left_done = 1;
-                                break;
-                        case diag:
-                                i = i + 1;
-                                j = j + 1;
-                                W->cells[i][j].diag_done = 1;
-                                break;
-                        default:
-                                unreachable();
+                        step->dirs = get_walk_directions(C, i, j);
+
+                        /* Note if the path runs along the edge of the
+                         * band, where a path leaving the band might
+                         * have scored higher */
+                        if (C->band >= 0 &&
+                            score_table_on_band_edge(C->score_table, i, j)) {
+                                C->touched_band_edge = 1;
                         }
 
-                        /* Decrement n so we can write in another
-                         * equivalent solution in a later pass */
-                        n = n - 1;
+                        /* We've reached the top-left corner of the
+                         * table, so we print the current solution
+                         * (i.e. aligned strings X & Y) to the standard
+                         * output and return to the cell we came
+                         * from. */
+                        if (i == 0 && j == 0) {
+                                if (qflag != 1 || lflag == 1) {
+                                        FILE *out = (NULL != piece ?
+                                                     piece_stream(piece) :
+                                                     stdout);
+                                        print_aligned_strings_and_counts(
+                                                out, X, Y, n - 1,
+                                                qflag, lflag);
+                                }
+                                constructed = constructed + 1;
+                                if (constructed == max) {
+                                        break;
+                                }
+                                depth = depth - 1;
+                                continue;
+                        }
                 }
 
-                /*
-                 * Recursive Case: Not done in current cell.  Iterate
-                 *                 into an adjacent (up/diag/left) cell
-                 *                 if we haven't yet marked the cell
-                 *                 "done."
-                 */
-                else {
-                        if (1 == W->cells[i][j].diag &&
-                            0 == W->cells[i][j].diag_done) {
+                /* Take the next optimal move out of the cell we haven't
+                 * taken yet, trying diag, then left, then up.  If there
+                 * is none, return to the cell we came from. */
+                struct walk_step to = {i, j, 0, 0};
+                int found = 0;
+                while (!found && step->next_move < 3) {
+                        int move = step->next_move;
+                        step->next_move = step->next_move + 1;
+
+                        if (move == 0 && (step->dirs & walk_diag)) {
                                 X[n] = C->top_string[i-1];
                                 Y[n] = C->side_string[j-1];
-                                i = i - 1;
-                                j = j - 1;
-                                W->cells[i][j].src_direction = diag;
-                        } else if (1 == W->cells[i][j].left &&
-                                   0 == W->cells[i][j].left_done) {
+                                to.col = i - 1;
+                                to.row = j - 1;
+                                found = 1;
+                        } else if (move == 1 && (step->dirs & walk_left)) {
                                 X[n] = C->top_string[i-1];
-                                Y[n] = '-';
-                                i = i - 1;
-                                W->cells[i][j].src_direction = left;
-                        } else if (1 == W->cells[i][j].up &&
-                                   0 == W->cells[i][j].up_done) {
-                                X[n] = '-';
+                                Y[n] = GAP_CHAR;
+                                to.col = i - 1;
+                                found = 1;
+                        } else if (move == 2 && (step->dirs & walk_up)) {
+                                X[n] = GAP_CHAR;
                                 Y[n] = C->side_string[j-1];
-                                j = j - 1;
-                                W->cells[i][j].src_direction = up;
+                                to.row = j - 1;
+                                found = 1;
                         }
+                }
 
-                        n = n + 1;
+                if (!found) {
+                        depth = depth - 1;
+                        continue;
                 }
+                stack[depth] = to;
+                depth = depth + 1;
         }
 
+        free(stack);
+
         debug("Finished alignment construction.");
+
+        return constructed;
 }
 
-struct walk_table_args {
-        computation_t *C;
-        char *X;
-        char *Y;
-        int start_i;
-        int start_j;
+/* Where construct_affine_alignments() is in a cell: at the best
+   alignment ending there, or at the best one ending in a left or an up
+   gap */
+typedef enum {in_cell, in_left_gap, in_up_gap} walk_layer_t;
+
+/* A step of the walk in construct_affine_alignments(): the cell, the
+   layer of it, the next move out of it to try, and the length of the
+   alignment built so far */
+struct affine_step {
+        int col;
+        int row;
+        walk_layer_t layer;
+        int next_move;
+        int n;
+};
+
+/*
+ * construct_affine_alignments()
+ *
+ *   Construct all optimal alignments of a computation scored with
+ *   affine gaps.  The walk moves between three layers of each cell:
+ *   from a cell we go diagonally, or into the cell's left or up gap
+ *   layer, and from a gap layer the gap opens after the neighbouring
+ *   cell or extends that cell's gap, so a step of the walk's stack
+ *   also records the layer it is in.  Moves are tried in a fixed order
+ *   and max_alignments limits the walk as in
+ *   construct_alignments_for_subtable().
+ *
+ *   C - computation instance to reconstruct alignments for
+ *
+ *   X - buffer to store the aligned top string in
+ *
+ *   Y - buffer to store the aligned side string in
+ */
+static void
+construct_affine_alignments(computation_t *C, char *X, char *Y)
+{
+        walk_table_t *W = C->walk_table;
+
+        /* Every move either emits a column of the alignment or enters
+           a gap layer, and gap layers only emit */
+        size_t max_depth = 2 * ((size_t)W->M + W->N) + 1;
+        struct affine_step *stack =
+                (struct affine_step *)malloc(max_depth *
+                                             sizeof(struct affine_step));
+        check(NULL != stack, "malloc failed");
+
+        stack[0] = (struct affine_step){W->M - 1, W->N - 1, in_cell, 0, 0};
+        int depth = 1;
+        int constructed = 0;
+
+        while (depth > 0) {
+                struct affine_step *step = &stack[depth-1];
+                int i = step->col;
+                int j = step->row;
+                walk_table_cell_t *cell = walk_table_cell(W, i, j);
+
+                if (step->next_move == 0) {
+                        if (tflag == 1) {
+                                *cell |= walk_optimal;
+                        }
+                        if (score_table_on_band_edge(C->score_table, i, j)) {
+                                C->touched_band_edge = 1;
+                        }
+                        if (i == 0 && j == 0) {
+                                if (qflag != 1 || lflag == 1) {
+                                        print_aligned_strings_and_counts(
+                                                stdout, X, Y, step->n - 1,
+                                                qflag, lflag);
+                                }
+                                constructed = constructed + 1;
+                                if (constructed == max_alignments) {
+                                        break;
+                                }
+                                depth = depth - 1;
+                                continue;
+                        }
+                }
+
+                /* Take the next open move out of this layer, if any */
+                struct affine_step to = {i, j, in_cell, 0, step->n};
+                int found = 0;
+                while (!found && step->next_move < 3) {
+                        int move = step->next_move;
+                        step->next_move = step->next_move + 1;
+
+                        switch (step->layer) {
+                        case in_cell:
+                                if (move == 0 && (*cell & walk_diag)) {
+                                        to.col = i - 1;
+                                        to.row = j - 1;
+                                        found = 1;
+                                } else if (move == 1 && (*cell & walk_left)) {
+                                        to.layer = in_left_gap;
+                                        found = 1;
+                                } else if (move == 2 && (*cell & walk_up)) {
+                                        to.layer = in_up_gap;
+                                        found = 1;
+                                }
+                                break;
+                        case in_left_gap:
+                                if ((move == 0 &&
+                                     (*cell & left_gap_open)) ||
+                                    (move == 1 &&
+                                     (*cell & left_gap_extend))) {
+                                        to.col = i - 1;
+                                        to.layer = (move == 0 ? in_cell :
+                                                    in_left_gap);
+                                        found = 1;
+                                }
+                                break;
+                        case in_up_gap:
+                                if ((move == 0 &&
+                                     (*cell & up_gap_open)) ||
+                                    (move == 1 &&
+                                     (*cell & up_gap_extend))) {
+                                        to.row = j - 1;
+                                        to.layer = (move == 0 ? in_cell :
+                                                    in_up_gap);
+                                        found = 1;
+                                }
+                                break;
+                        default:
+                                unreachable();
+                        }
+                }
+
+                if (!found) {
+                        depth = depth - 1;
+                        continue;
+                }
+
+                /* Moving to another cell emits a column of the
+                   alignment */
+                if (to.col != i || to.row != j) {
+                        X[step->n] = (to.col != i ?
+                                      C->top_string[i-1] : GAP_CHAR);
+                        Y[step->n] = (to.row != j ?
+                                      C->side_string[j-1] : GAP_CHAR);
+                        to.n = step->n + 1;
+                }
+                stack[depth] = to;
+                depth = depth + 1;
+        }
+
+        free(stack);
+}
+
+/*
+ * next_random()
+ *
+ *   Advance the xorshift64* generator whose state is *state, and return
+ *   a number drawn uniformly from [0, 1).
+ */
+static double
+next_random(uint64_t *state)
+{
+        uint64_t x = *state;
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+        *state = x;
+        return ((x * 0x2545F4914F6CDD1DULL) >> 11) * 0x1.0p-53;
+}
+
+/*
+ * choose_weighted()
+ *
+ *   Draw one of n choices with probability proportional to 2^w, where
+ *   w is its weight in weights, and return its index.  At least one
+ *   weight must be finite.
+ */
+static int
+choose_weighted(const double *weights, int n, uint64_t *state)
+{
+        double top = -INFINITY;
+        for (int i = 0; i < n; i++) {
+                if (top < weights[i])
+                        top = weights[i];
+        }
+
+        double p[3];
+        double total = 0;
+        for (int i = 0; i < n; i++) {
+                p[i] = exp2(weights[i] - top);
+                total = total + p[i];
+        }
+
+        /* Fall back on the last possible choice if rounding leaves u
+           past the end */
+        double u = next_random(state) * total;
+        int choice = -1;
+        for (int i = 0; i < n; i++) {
+                if (p[i] > 0) {
+                        choice = i;
+                        if (u < p[i])
+                                break;
+                        u = u - p[i];
+                }
+        }
+        return choice;
+}
+
+/*
+ * sample_alignment()
+ *
+ *   Construct one optimal alignment drawn uniformly at random and print
+ *   it as construct_alignments_for_subtable() would.  Walking back from
+ *   the bottom-right cell, each optimal step is taken with probability
+ *   proportional to the number of paths from the top-left cell to the
+ *   cell (or gap layer) it leads to, so every path is equally likely.
+ *
+ *   C - computation instance to draw an alignment of
+ *
+ *   P - path weights of the computation (see weigh_paths())
+ *
+ *   X - buffer to store the aligned top string in
+ *
+ *   Y - buffer to store the aligned side string in
+ *
+ *   state - state of the random number generator
+ */
+static void
+sample_alignment(computation_t *C,
+                 const path_weights_t *P,
+                 char *X,
+                 char *Y,
+                 uint64_t *state)
+{
+        walk_table_t *W = C->walk_table;
+        int affine = NULL != P->left_gaps;
+        walk_layer_t layer = in_cell;
+        int i = P->M - 1;
+        int j = P->N - 1;
+        int n = 0;
+
+        for (;;) {
+                if (NULL != W && tflag == 1) {
+                        *walk_table_cell(W, i, j) |= walk_optimal;
+                }
+                if (C->band >= 0 &&
+                    score_table_on_band_edge(C->score_table, i, j)) {
+                        C->touched_band_edge = 1;
+                }
+                if (i == 0 && j == 0) {
+                        break;
+                }
+
+                walk_table_cell_t dirs = get_walk_directions(C, i, j);
+                double w[3] = {-INFINITY, -INFINITY, -INFINITY};
+                int move;
+
+                switch (layer) {
+                case in_cell:
+                        if (dirs & walk_diag)
+                                w[0] = *path_weight(P, P->cells, i-1, j-1);
+                        if (dirs & walk_left)
+                                w[1] = affine ?
+                                        *path_weight(P, P->left_gaps, i, j) :
+                                        *path_weight(P, P->cells, i-1, j);
+                        if (dirs & walk_up)
+                                w[2] = affine ?
+                                        *path_weight(P, P->up_gaps, i, j) :
+                                        *path_weight(P, P->cells, i, j-1);
+                        move = choose_weighted(w, 3, state);
+
+                        /* With affine gaps, a gap is entered without
+                           moving; its layer emits the columns */
+                        if (move != 0 && affine) {
+                                layer = (move == 1 ? in_left_gap :
+                                         in_up_gap);
+                                continue;
+                        }
+                        X[n] = (move != 2 ? C->top_string[i-1] : GAP_CHAR);
+                        Y[n] = (move != 1 ? C->side_string[j-1] : GAP_CHAR);
+                        i = (move != 2 ? i - 1 : i);
+                        j = (move != 1 ? j - 1 : j);
+                        break;
+                case in_left_gap:
+                        if (dirs & left_gap_open)
+                                w[0] = *path_weight(P, P->cells, i-1, j);
+                        if (dirs & left_gap_extend)
+                                w[1] = *path_weight(P, P->left_gaps, i-1, j);
+                        move = choose_weighted(w, 2, state);
+                        X[n] = C->top_string[i-1];
+                        Y[n] = GAP_CHAR;
+                        i = i - 1;
+                        layer = (move == 0 ? in_cell : in_left_gap);
+                        break;
+                case in_up_gap:
+                        if (dirs & up_gap_open)
+                                w[0] = *path_weight(P, P->cells, i, j-1);
+                        if (dirs & up_gap_extend)
+                                w[1] = *path_weight(P, P->up_gaps, i, j-1);
+                        move = choose_weighted(w, 2, state);
+                        X[n] = GAP_CHAR;
+                        Y[n] = C->side_string[j-1];
+                        j = j - 1;
+                        layer = (move == 0 ? in_cell : in_up_gap);
+                        break;
+                default:
+                        unreachable();
+                }
+                n = n + 1;
+        }
+
+        if (qflag != 1 || lflag == 1) {
+                print_aligned_strings_and_counts(stdout, X, Y, n - 1,
+                                                 qflag, lflag);
+        }
+}
+
+/*
+ * sample_alignments()
+ *
+ *   Construct num_samples optimal alignments of a computation, each
+ *   drawn uniformly at random and independently of the others, with
+ *   random numbers seeded by sample_seed.
+ *
+ *   C - computation instance to draw alignments of
+ *
+ *   X - buffer to store the aligned top string in
+ *
+ *   Y - buffer to store the aligned side string in
+ */
+static void
+sample_alignments(computation_t *C, char *X, char *Y)
+{
+        path_weights_t *P = weigh_paths(C);
+
+        /* xorshift64* needs a nonzero state */
+        uint64_t state = (uint64_t)sample_seed ^ 0x9E3779B97F4A7C15ULL;
+        if (state == 0) {
+                state = 1;
+        }
+
+        for (int s = 0; s < num_samples; s++) {
+                sample_alignment(C, P, X, Y, &state);
+        }
+
+        free_path_weights(P);
+}
+
+/*
+ * follow_walk()
+ *
+ *   Extend the traceback piece T through cells with a single optimal
+ *   direction, stopping at the top-left corner, a branch, or a cell
+ *   with no way out.  Returns the stopping cell's directions.
+ */
+static walk_table_cell_t
+follow_walk(struct walk_table_args *T)
+{
+        computation_t *C = T->C;
+
+        /* The cells of row 0 and column 0 carry gap_move_t bits even
+           with linear gaps (see init_computation_tables()).  Keep just
+           the directions, so that a border cell compares equal to the
+           one direction out of it. */
+        walk_table_cell_t moves = walk_diag | walk_left | walk_up;
+
+        for (;;) {
+                int i = T->start_i;
+                int j = T->start_j;
+                int n = T->start_n;
+
+                if (C->band >= 0 &&
+                    score_table_on_band_edge(C->score_table, i, j)) {
+                        C->touched_band_edge = 1;
+                }
+                if (i == 0 && j == 0) {
+                        return 0;
+                }
+
+                walk_table_cell_t dirs = get_walk_directions(C, i, j) & moves;
+                if (dirs == walk_diag) {
+                        T->X[n] = C->top_string[i-1];
+                        T->Y[n] = C->side_string[j-1];
+                        T->start_i = i - 1;
+                        T->start_j = j - 1;
+                } else if (dirs == walk_left) {
+                        T->X[n] = C->top_string[i-1];
+                        T->Y[n] = GAP_CHAR;
+                        T->start_i = i - 1;
+                } else if (dirs == walk_up) {
+                        T->X[n] = GAP_CHAR;
+                        T->Y[n] = C->side_string[j-1];
+                        T->start_j = j - 1;
+                } else {
+                        return dirs;
+                }
+                T->start_n = n + 1;
+        }
+}
+
+/*
+ * split_traceback()
+ *
+ *   Split the traceback of a computation into pieces for its thread
+ *   pool.  Starting from the whole walk, every piece is followed to
+ *   its next branch and replaced by one piece per optimal move out of
+ *   the branch, tried in the order construct_alignments_for_subtable()
+ *   tries them, until there are a few pieces per thread.  The pieces
+ *   thus list the alignments in the same order as a single walk.
+ *
+ *   C - computation instance to split the traceback of
+ *
+ *   M, N - dimensions of the computation's table
+ *
+ *   num_pieces - where to store the number of pieces
+ *
+ *   Returns the pieces, whose X and Y buffers the caller frees.
+ */
+static struct walk_table_args *
+split_traceback(computation_t *C, int M, int N, int *num_pieces)
+{
+        size_t buflen = (size_t)M + N + 1;
+        int target = 4 * C->num_threads;
+        int count = 1;
+
+        /* A round can at most triple the pieces */
+        struct walk_table_args *pieces =
+                (struct walk_table_args *)calloc(3 * target,
+                                                 sizeof(*pieces));
+        struct walk_table_args *next =
+                (struct walk_table_args *)calloc(3 * target,
+                                                 sizeof(*next));
+        check(NULL != pieces && NULL != next, "calloc failed");
+
+        pieces[0].C = C;
+        pieces[0].X = (char *)malloc(buflen);
+        pieces[0].Y = (char *)malloc(buflen);
+        check(NULL != pieces[0].X && NULL != pieces[0].Y, "malloc failed");
+        pieces[0].start_i = M - 1;
+        pieces[0].start_j = N - 1;
+
+        int split = 1;
+        while (split && count < target) {
+                int next_count = 0;
+                split = 0;
+
+                for (int p = 0; p < count; p++) {
+                        struct walk_table_args T = pieces[p];
+                        walk_table_cell_t dirs = follow_walk(&T);
+
+                        /* Keep the piece whole if it doesn't branch or
+                           splitting it would overshoot */
+                        int moves = !!(dirs & walk_diag) +
+                                !!(dirs & walk_left) + !!(dirs & walk_up);
+                        if (moves < 2 ||
+                            next_count + moves + (count - p - 1) > 3 * target) {
+                                next[next_count++] = T;
+                                continue;
+                        }
+
+                        int i = T.start_i;
+                        int j = T.start_j;
+                        int n = T.start_n;
+                        int first = 1;
+                        for (int move = 0; move < 3; move++) {
+                                struct walk_table_args U = T;
+                                if (move == 0 && (dirs & walk_diag)) {
+                                        U.start_i = i - 1;
+                                        U.start_j = j - 1;
+                                } else if (move == 1 && (dirs & walk_left)) {
+                                        U.start_i = i - 1;
+                                } else if (move == 2 && (dirs & walk_up)) {
+                                        U.start_j = j - 1;
+                                } else {
+                                        continue;
+                                }
+
+                                /* The first piece out of the branch
+                                   keeps the buffers; the others copy
+                                   the alignment so far */
+                                if (!first) {
+                                        U.X = (char *)malloc(buflen);
+                                        U.Y = (char *)malloc(buflen);
+                                        check(NULL != U.X && NULL != U.Y,
+                                              "malloc failed");
+                                        memcpy(U.X, T.X, n);
+                                        memcpy(U.Y, T.Y, n);
+                                }
+                                first = 0;
+
+                                U.X[n] = (U.start_i < i ?
+                                          C->top_string[i-1] : GAP_CHAR);
+                                U.Y[n] = (U.start_j < j ?
+                                          C->side_string[j-1] : GAP_CHAR);
+                                U.start_n = n + 1;
+                                next[next_count++] = U;
+                        }
+                        split = 1;
+                }
+
+                struct walk_table_args *swap = pieces;
+                pieces = next;
+                next = swap;
+                count = next_count;
+        }
+
+        free(next);
+        *num_pieces = count;
+        return pieces;
+}
+
+/* The pieces of a parallel traceback and the earliest of them not
+   yet printed */
+struct parallel_walk {
+        struct walk_table_args *pieces;
+        int count;
+        int head;
+        pthread_mutex_t mutex;
 };
 
+/*
+ * advance_head()
+ *
+ *   Print the finished pieces at the head of a parallel traceback's
+ *   output, and let the first unfinished one print straight to the
+ *   standard output.  The caller holds W->mutex, or is the only
+ *   thread.
+ */
+static void
+advance_head(struct parallel_walk *W)
+{
+        while (W->head < W->count && W->pieces[W->head].done) {
+                struct walk_table_args *T = &W->pieces[W->head];
+                if (NULL != T->text) {
+                        fwrite(T->text, 1, T->size, stdout);
+                        free(T->text);
+                        T->text = NULL;
+                }
+                W->head = W->head + 1;
+        }
+        if (W->head < W->count) {
+                atomic_store(&W->pieces[W->head].at_head, 1);
+        }
+}
+
+/*
+ * walk_subtable_task()
+ *
+ *   Construct the alignments of one traceback piece.  Runs on the
+ *   computation's thread pool.
+ *
+ *   P - the computation's thread pool
+ *
+ *   arg - the parallel traceback
+ *
+ *   piece - index of the piece to construct
+ */
+static void
+walk_subtable_task(thread_pool_t *P, void *arg, long piece)
+{
+        (void)P;
+        struct parallel_walk *W = (struct parallel_walk *)arg;
+        struct walk_table_args *T = &W->pieces[piece];
+
+        construct_alignments_for_subtable(T->C, T->X, T->Y, T->start_i,
+                                          T->start_j, T->start_n, T, T->max);
+        if (NULL != T->stream && T->stream != stdout) {
+                fclose(T->stream);
+        }
+
+        pthread_mutex_lock(&W->mutex);
+        T->done = 1;
+        if (W->head == piece) {
+                advance_head(W);
+        }
+        pthread_mutex_unlock(&W->mutex);
+}
+
+/*
+ * construct_alignments_in_parallel()
+ *
+ *   Construct all optimal alignments of a computation on its thread
+ *   pool, one traceback piece per task, and print them in the order a
+ *   single walk would.  The earliest unfinished piece prints as it
+ *   goes; later pieces hold their alignments in memory until it is
+ *   done.  With -k, the pieces' alignments are counted first, and each
+ *   piece constructs only the ones that fit in max_alignments after
+ *   the pieces before it.
+ *
+ *   C - computation instance to construct optimal alignments for
+ *
+ *   M, N - dimensions of the computation's table
+ */
+static void
+construct_alignments_in_parallel(computation_t *C, int M, int N)
+{
+        struct parallel_walk W;
+        W.pieces = split_traceback(C, M, N, &W.count);
+        W.head = 0;
+        int res = pthread_mutex_init(&W.mutex, NULL);
+        check(0 == res, "pthread_mutex_init failed");
+
+        if (max_alignments > 0) {
+                int *cols = (int *)malloc(W.count * sizeof(int));
+                int *rows = (int *)malloc(W.count * sizeof(int));
+                path_count_t *counts =
+                        (path_count_t *)malloc(W.count * sizeof(path_count_t));
+                check(NULL != cols && NULL != rows && NULL != counts,
+                      "malloc failed");
+                for (int p = 0; p < W.count; p++) {
+                        cols[p] = W.pieces[p].start_i;
+                        rows[p] = W.pieces[p].start_j;
+                }
+                count_paths_to_cells(C, W.count, cols, rows, counts);
+
+                int remaining = max_alignments;
+                for (int p = 0; p < W.count; p++) {
+                        struct walk_table_args *T = &W.pieces[p];
+                        T->max = (counts[p] < (path_count_t)remaining ?
+                                  (int)counts[p] : remaining);
+                        remaining = remaining - T->max;
+
+                        /* Pieces left nothing to construct are done */
+                        T->done = (T->max == 0);
+                }
+                free(cols);
+                free(rows);
+                free(counts);
+        }
+        advance_head(&W);
+
+        /* Submit the pieces last to first: the workers take their
+           newest task first, so they start on the earliest pieces */
+        for (int p = W.count - 1; p >= 0; p--) {
+                if (!W.pieces[p].done) {
+                        thread_pool_submit(C->pool, walk_subtable_task,
+                                           &W, p);
+                }
+        }
+        thread_pool_wait(C->pool);
+
+        /* Each piece owns its buffers: the first piece out of a branch
+           took them over from the branch's piece */
+        for (int p = 0; p < W.count; p++) {
+                free(W.pieces[p].X);
+                free(W.pieces[p].Y);
+        }
+        free(W.pieces);
+        pthread_mutex_destroy(&W.mutex);
+}
+
 /*
  * construct_alignments()
  *
@@ -345,11 +1100,11 @@ struct walk_table_args {
  *   computation instance.  It the '-q' flag is not set, all optimal
  *   alignments will be printed to the standard output.
  *
- *   NOTE: This routine could be modified to run
- *         construct_alignments_for_subtable() in parallel, which would
- *         significantly improve performance for large/dissimilar input
- *         strings (i.e. strings that produce computations with hundreds
- *         of thousands of branches in their reference walk table).
+ *   With more than one thread, the traceback is split at its first
+ *   branches and the pieces are walked on the computation's thread
+ *   pool.  It stays a single walk when the walk marks the table for
+ *   -t, when the computation keeps checkpoints (rescoring their strips
+ *   isn't thread-safe), or when gaps are affine.
  *
  *   C - computation instance to construct optimal alignments for
  */
@@ -360,9 +1115,22 @@ construct_alignments(computation_t *C)
         char *X;
         char *Y;
 
+        /* The table's dimensions, whether it is kept whole or in
+           checkpoints */
+        int M = NULL != C->checkpoints ? C->checkpoints->M :
+                C->score_table->M;
+        int N = NULL != C->checkpoints ? C->checkpoints->N :
+                C->score_table->N;
+
+        if (num_samples == 0 && NULL != C->pool && NULL == C->checkpoints &&
+            tflag != 1 && C->gap_extend_penalty == C->indel_penalty) {
+                construct_alignments_in_parallel(C, M, N);
+                return;
+        }
+
         /* Allocate buffers for printing the optimally aligned strings.  In the
            worst case they will need to be M+N characters long. */
-        max_aligned_strlen = C->score_table->M + C->score_table->N;
+        max_aligned_strlen = M + N;
 
         debug("Allocated temporary solution printing strings X and Y.");
 
@@ -373,14 +1141,21 @@ construct_alignments(computation_t *C)
 
         /* We walk through the table starting at the bottom-right-hand
          * corner */
-        int i = C->score_table->M - 1;  /* starting column */
-        int j = C->score_table->N - 1;  /* starting row */
+        int i = M - 1;  /* starting column */
+        int j = N - 1;  /* starting row */
         int n = 0;                      /* starting character count */
 
         /* Walk the table starting at the bottom-right corner, marking cells in
          * the optimal path and counting the total possible optimal solutions
          * (alignments) */
-        construct_alignments_for_subtable(C, X, Y, i, j, n);
+        if (num_samples > 0) {
+                sample_alignments(C, X, Y);
+        } else if (C->gap_extend_penalty != C->indel_penalty) {
+                construct_affine_alignments(C, X, Y);
+        } else {
+                construct_alignments_for_subtable(C, X, Y, i, j, n,
+                                                  NULL, max_alignments);
+        }
 
         /* Clean up solution storage buffers */
         free(X);
@@ -388,241 +1163,338 @@ construct_alignments(computation_t *C)
 }
 
 /*
- * max3()
+ * score_band_column()
  *
- *   Return the maximum of the set {a, b, c}.
+ *   Write alignment scores to the cells first_row through last_row of
+ *   column col that lie in the computation's band, if it has one.
  */
-static int
-max3(int a, int b, int c)
+static inline void
+score_band_column(computation_t *C, int col, int first_row, int last_row)
 {
-        int m = a;
-        if (m < b)
-                m = b;
-        if (m < c)
-                m = c;
-        return m;
+        int first = score_table_first_row(C->score_table, col);
+        int last = score_table_last_row(C->score_table, col);
+
+        if (first < first_row)
+                first = first_row;
+        if (last > last_row)
+                last = last_row;
+        if (first <= last) {
+                C->score_column(C, col, first, last);
+        }
 }
 
 /*
- * score_cell()
- *
- *   Write the alignment score to the score_table cell at (col,row).
+ * score_tile()
  *
- *   C - pointer to computation_t instance containing the target
- *       score_table
+ *   Write alignment scores to every cell of a tile of a computation's
+ *   score table, one column at a time.
  *
- *   col - column of the target cell in the score table
+ *   C - target computation instance
  *
- *   row - row of the target cell in the score table
+ *   tile - index of the tile in the computation's wavefront
  */
-void
-score_cell(computation_t *C, int col, int row)
+static void
+score_tile(computation_t *C, int tile)
 {
-        /* Cell we want to compute the score for */
-        score_table_cell_t *target_cell = &C->score_table->cells[col][row];
-
-        /* Cells we'll use to compute target_cell's score */
-        score_table_cell_t *up_cell   = &C->score_table->cells[col][row-1];
-        score_table_cell_t *diag_cell = &C->score_table->cells[col-1][row-1];
-        score_table_cell_t *left_cell = &C->score_table->cells[col-1][row];
-
-        /* Candidate scores */
-        int up_score = up_cell->score - C->indel_penalty;
-        int diag_score = 0;
-        if (C->top_string[col-1] == C->side_string[row-1]) {
-                diag_score = diag_cell->score + C->match_score;
-                target_cell->match = 1;
-        } else {
-                diag_score = diag_cell->score - C->mismatch_penalty;
-                target_cell->match = 0;
-        }
-
-        /***************************
-         * BEGIN CRITICAL SECTIONS *
-         ***************************/
+        int first_col, last_col, first_row, last_row;
+        tile_bounds(C->wavefront, tile,
+                    &first_col, &last_col, &first_row, &last_row);
 
-        if (C->num_threads > 1) {
-                /* Wait for signal that left_cell is processed, then
-                   lock the left cell's score mutex. */
-                pthread_mutex_lock(&left_cell->score_mutex);
-                while (1 != left_cell->processed) {
-                        pthread_cond_wait(&left_cell->processed_cv,
-                                          &left_cell->score_mutex);
-                }
+        for (int col = first_col; col <= last_col; col++) {
+                score_band_column(C, col, first_row, last_row);
         }
+}
 
-        int left_score = left_cell->score - C->indel_penalty;
+/*
+ * score_tile_task()
+ *
+ *   Score one ready tile of a computation's score table, then submit
+ *   the tiles that became ready as a result.  This runs as a task in
+ *   the computation's thread pool.
+ *
+ *   P - the computation's thread pool
+ *
+ *   arg - pointer to the target computation instance
+ *
+ *   tile - index of the tile in the computation's wavefront
+ */
+static void
+score_tile_task(thread_pool_t *P, void *arg, long tile)
+{
+        computation_t *C = (computation_t *)arg;
+        int ready[2];
 
-        if (C->num_threads > 1) {
-                /* We're done with the left score, so free the mutex */
-                pthread_mutex_unlock(&left_cell->score_mutex);
+        score_tile(C, tile);
 
-                /* Lock current cell's score mutex and process the cell */
-                pthread_mutex_lock(&target_cell->score_mutex);
+        /* Submit the tile below before the tile to the right: the
+           worker pops its newest task first, so it carries on along
+           its row of tiles and leaves the row below to thieves. */
+        int n = finish_tile(C->wavefront, tile, ready);
+        for (int i = 0; i < n; i++) {
+                thread_pool_submit(P, score_tile_task, C, ready[i]);
         }
+}
 
-        /* The current cell's score is the max of the three candidate scores */
-        target_cell->score = max3(up_score, left_score, diag_score);
-
-        if (C->num_threads > 1) {
-                /* We've finalized the cell's score, so we mark it as
-                 * processed for any waiting thread. */
-                target_cell->processed = 1;
-
-                /* Signal the waiting thread and release the score mutex */
-                pthread_cond_signal(&target_cell->processed_cv);
-                pthread_mutex_unlock(&target_cell->score_mutex);
+/*
+ * compute_xdrop_scores()
+ *
+ *   Score a computation's table one column at a time, X-drop style.  A
+ *   cell is live unless its score has fallen more than C->xdrop below
+ *   the best score seen so far.  Each column is scored from the first
+ *   live row of the column to its left down to one row past the last,
+ *   and then further down for as long as the cell above stays live;
+ *   the run is then trimmed to its live rows.  The cells bordering the
+ *   run are set to -infinity, so no later column builds on a dead or
+ *   unscored cell.  We give up if a column has no live cells or the
+ *   last column falls short of the bottom-right corner.
+ *
+ *   C - target computation instance
+ */
+static void
+compute_xdrop_scores(computation_t *C)
+{
+        score_table_t *S = C->score_table;
+        int d = C->indel_penalty;
+        int best = 0;
+
+        /* Live rows of the previous column.  Column 0 was scored by
+           init_computation_tables(). */
+        int *this = score_table_column(S, 0);
+        int lo = 0;
+        int hi = 0;
+        while (hi < score_table_last_row(S, 0) && this[hi+1] >= -C->xdrop) {
+                hi = hi + 1;
         }
+        C->cells_scored = score_table_last_row(S, 0) + 1;
+
+        for (int col = 1; col < S->M; col++) {
+                int band_last = score_table_last_row(S, col);
+                int first = score_table_first_row(S, col);
+                int last = hi + 1 < band_last ? hi + 1 : band_last;
+                this = score_table_column(S, col);
+
+                /* Row 0 was scored along with the table, and stays in
+                   the run while the cell to its left is live */
+                int top = (lo == 0 && first == 0) ? 0 : -1;
+                if (first < lo)
+                        first = lo;
+                if (first < 1)
+                        first = 1;
+                if (top != 0) {
+                        this[first-1] = SCORE_NEG_INF;
+                        top = first;
+                }
+
+                if (first <= last) {
+                        C->score_column(C, col, first, last);
+                }
+                for (int row = top; row <= last; row++) {
+                        if (best < this[row])
+                                best = this[row];
+                }
 
-        /*************************
-         * END CRITICAL SECTIONS *
-         *************************/
+                /* Below the last row of the previous column's run,
+                   only the up direction is open */
+                while (last < band_last && this[last] - d >= best - C->xdrop) {
+                        last = last + 1;
+                        this[last] = this[last-1] - d;
+                        mark_walk_cell(C->walk_table, col, last, 0, 1, 0);
+                }
+                C->cells_scored += last - top + 1;
 
-        /* Mark the optimal paths in the walk table.  Provided that a
-           path's score is equal to the target cell's score, i.e. the
-           maximum of the three candidate scores, it is an optimal
-           path. */
-        walk_table_cell_t *target_walk_cell = &C->walk_table->cells[col][row];
-        if (target_cell->score == diag_score) {
-                target_walk_cell->diag = 1;
-                target_walk_cell->diag_done = 0;
-        } else {
-                target_walk_cell->diag_done = 1;
-        }
-        if (target_cell->score == up_score) {
-                target_walk_cell->up = 1;
-                target_walk_cell->up_done = 0;
-        } else {
-                target_walk_cell->up_done = 1;
-        }
-        if (target_cell->score == left_score) {
-                target_walk_cell->left = 1;
-                target_walk_cell->left_done = 0;
-        } else {
-                target_walk_cell->left_done = 1;
-        }
+                if (col == S->M - 1) {
+                        check(top <= last && last == S->N - 1,
+                              "X-drop of %d ended every path before the "
+                              "last cell", C->xdrop);
+                        break;
+                }
 
-        /* If we can branch here, i.e. multiple paths have the same
-           scores, note it. */
-        if (target_walk_cell->diag + target_walk_cell->up + target_walk_cell->left > 1) {
-                inc_branch_count(C->walk_table, C->num_threads);
+                /* Trim the run to its live rows */
+                lo = top;
+                while (lo <= last && this[lo] < best - C->xdrop) {
+                        lo = lo + 1;
+                }
+                hi = last;
+                while (hi >= lo && this[hi] < best - C->xdrop) {
+                        hi = hi - 1;
+                }
+                check(lo <= hi,
+                      "X-drop of %d ended every path before the last cell",
+                      C->xdrop);
+                if (lo > 0)
+                        this[lo-1] = SCORE_NEG_INF;
+                if (hi < S->N - 1)
+                        this[hi+1] = SCORE_NEG_INF;
         }
 }
 
 /*
- * score_cell_column()
- *
- *   Write alignment scores to a column of cells in a computation's
- *   score table.
+ * compute_table_scores()
  *
- *     C - pointer to the computation instance containing the target
- *         score table
+ *   Score each cell in a computation instance's score table, or just
+ *   the cells in its band if it has one.  With one thread we sweep the
+ *   table column by column.  With more, the computation's thread pool
+ *   scores tiles in wavefront order: a tile is scored once the tiles
+ *   above it and to its left are done.
+ *   Columns are scored with the column kernel of the selected kernel
+ *   set (see kernels.h), or with its kernel built for the computation's
+ *   scoring parameters if PARAMS listed them, or with its kernels for
+ *   affine gaps or a substitution matrix.  A computation keeping
+ *   checkpoints instead of a score table is scored a strip at a time
+ *   (see checkpoint.c).
  *
- *   col - index of the column of cells to score
+ *   C - target computation instance
  */
 void
-score_cell_column(computation_t *C, int col)
+compute_table_scores(computation_t *C)
 {
-        score_table_t *S = C->score_table;
-
-        /* Compute the score for each cell in the column */
-        for (int row = 1; row < C->score_table->N; row++) {
-                /* Compute the cell's score */
-                score_cell(C, col, row);
-
-                /*
-                 * If we're printing the table and the absolute value of
-                 * the current cell's score is greater than the one
-                 * marked in the table, update the largest value.
-                 */
-                int current_abs_score = abs(S->cells[col][row].score);
-                if (tflag == 1 && current_abs_score > S->greatest_abs_val) {
-                        S->greatest_abs_val = current_abs_score;
+        C->score_column = choose_column_kernel(get_kernels(), C);
+
+        if (NULL != C->checkpoints) {
+                fill_checkpoint_table(C->checkpoints);
+        } else if (C->xdrop >= 0) {
+                compute_xdrop_scores(C);
+        } else if (C->num_threads == 1) {
+                for (int col = 1; col < C->score_table->M; col++) {
+                        score_band_column(C, col, 1, C->score_table->N - 1);
                 }
+        } else if (C->wavefront->tiles_x > 0 && C->wavefront->tiles_y > 0) {
+                /* The top-left tile depends on nothing; every other
+                   tile is submitted by the task that readies it */
+                thread_pool_submit(C->pool, score_tile_task, C, 0);
+                thread_pool_wait(C->pool);
+        }
+
+        if (NULL != C->walk_table) {
+                debug("%lu branches in walk table\n",
+                      get_branch_count(C->walk_table));
         }
 }
 
 /*
- * score_cell_column_set()
- *
- *   Write alignment scores to a set of cell columns in a computation's
- *   score table.  Given a starting column x, the current thread will score
- *   columns x + i*num_threads for i=0 until x + i*num_threads exceeds the
- *   total number of columns in the table.
+ * optimal_score()
  *
- *   args - pointer to a struct process_col_set_args, which contains a
- *          pointer to the target computation instance and a column
- *          index for the thread to start with
+ *   Return the optimal alignment score of s1 and s2 without building
+ *   the score or walk tables.  With affine gaps we keep two columns of
+ *   scores and one of left gap scores.  If the scoring parameters
+ *   reduce to edit distance we use the bit-parallel engine.  Otherwise
+ *   we use the selected kernel set's score-only engine, if it has one,
+ *   and keep two columns of scores if not.  Within a band (see -b) or with an
+ *   X-drop threshold (see -x), only the tables give the right score,
+ *   but we fill just a small part of them.  If engine isn't NULL, the
+ *   name of the engine we used is written to it, truncated to len
+ *   bytes.  See needleman_wunsch() for the other parameters.
  */
-void *
-score_cell_column_set(void *args)
+static int
+optimal_score(char *s1,
+              char *s2,
+              int m,
+              int k,
+              int d,
+              int e,
+              int num_threads,
+              char *engine,
+              size_t len)
 {
-        /* Unpack arguments.  We pass them in a struct because pthreads
-           only lets us pass a block of memory as argument to the
-           initial function */
-        struct process_col_set_args *A = (struct process_col_set_args *)args;
-        int current_col = A->start_col;
-        computation_t *C = A->C;
-
-        /* Process all columns in the thread's column set */
-        while (current_col < C->score_table->M) {
-                score_cell_column(C, current_col);
-                current_col = current_col + C->num_threads;
+        const kernel_set_t *K = get_kernels();
+        int score;
+
+        if (band >= 0 || xdrop >= 0) {
+                computation_t *C = alloc_computation();
+                init_computation(C, s1, s2, m, k, d, e, matrix, num_threads,
+                                 band, xdrop, keep_score_table);
+                compute_table_scores(C);
+                score = score_table_get(C->score_table,
+                                        C->score_table->M - 1,
+                                        C->score_table->N - 1);
+                free_computation(C);
+                if (NULL != engine)
+                        snprintf(engine, len, "%s kernels", K->name);
+        } else if (e != d) {
+                score = score_two_columns_affine(s1, s2, m, k, d, e, matrix);
+                if (NULL != engine)
+                        snprintf(engine, len, "two-column affine gap engine");
+        } else if (NULL == matrix && is_unit_cost(m, k, d)) {
+                score = unit_cost_score(s1, s2, m, d);
+                if (NULL != engine)
+                        snprintf(engine, len, "bit-parallel edit distance "
+                                 "engine");
+        } else if (NULL != K->score_only) {
+                score = K->score_only(s1, s2, m, k, d, matrix);
+                if (NULL != engine)
+                        snprintf(engine, len, "%s kernels", K->name);
+        } else {
+                score = score_two_columns(s1, s2, m, k, d, matrix);
+                if (NULL != engine)
+                        snprintf(engine, len, "two-column engine");
         }
-
-        return NULL; /* FIXME: Return some value indicating success? */
+        return score;
 }
 
 /*
- * compute_table_scores()
+ * print_optimal_score()
  *
- *   Score each cell in a computation instance's score table.
+ *   Print the optimal alignment score of s1 and s2 to standard output,
+ *   and the engine that computed it to standard error if sflag is set.
+ *   See needleman_wunsch() for the parameters.
+ */
+static void
+print_optimal_score(char *s1,
+                    char *s2,
+                    int m,
+                    int k,
+                    int d,
+                    int e,
+                    int num_threads)
+{
+        char engine[64];
+
+        printf("%d\n", optimal_score(s1, s2, m, k, d, e, num_threads,
+                                     engine, sizeof(engine)));
+        if (sflag == 1)
+                fprintf(stderr, "Scored with the %s\n", engine);
+}
+
+/*
+ * align_in_linear_space()
  *
- *   C - target computation instance
+ *   Find one optimal alignment of s1 and s2 with Hirschberg's
+ *   algorithm, which needs neither a score table nor a walk table, and
+ *   print it as needleman_wunsch() would.  See needleman_wunsch() for
+ *   the parameters.
  */
-void
-compute_table_scores(computation_t *C)
+static void
+align_in_linear_space(char *s1, char *s2, int m, int k, int d, int e)
 {
-        /* Allocate storage for thread ids and arguments to process_col_set */
-        C->worker_threads = (pthread_t *)malloc(C->num_threads * sizeof(pthread_t));
-        check(NULL != C->worker_threads, "malloc failed");
-        struct process_col_set_args *args;
-        args = (struct process_col_set_args *)malloc(C->num_threads *
-                                                     sizeof(struct process_col_set_args));
-        check(NULL != args, "malloc failed");
-
-        /* Spawn worker threads to process sets of columns */
-        debug("Spawning %d worker thread%s for scores table computation",
-              C->num_threads, (C->num_threads == 1 ? "" : "s"));
-        for (unsigned int i = 0; i < C->num_threads; i++) {
-                /* Initialize thread-local arguments for processing a
-                 * set of cell-columns */
-                args[i].start_col = i + 1;
-                args[i].C = C;
-
-                /* Spawn the thread */
-                int res = pthread_create(&C->worker_threads[i],
-                                         NULL,
-                                         score_cell_column_set,
-                                         &args[i]);
-                check(0 == res, "pthread_create failed");
-        }
-
-        /* Join the worker threads */
-        int res;
-        unsigned int join_count = 0;
-        for (unsigned int i = 0; i < C->num_threads; i++) {
-                res = pthread_join(C->worker_threads[i], NULL);
-                check(0 == res, "pthread_join failed");
-                join_count = join_count + 1;
-                debug("Joined thread %d", i+1);
-        }
-        check(join_count == C->num_threads, "this should never happen");
-        debug("Joined %d worker thread%s", C->num_threads,
-              (C->num_threads == 1 ? "" : "s"));
-        free(C->worker_threads);
-        debug("%u branches in walk table\n",
-              get_branch_count(C->walk_table, C->num_threads));
+        check(e == d, "-a hirschberg supports only linear gaps");
+        check(tflag != 1, "-t needs the score table, "
+              "which -a hirschberg doesn't build");
+        check(band < 0 && xdrop < 0, "-b and -x limit the score table, "
+              "which -a hirschberg doesn't build");
+        check(num_samples == 0, "-n draws from every optimal alignment, "
+              "but -a hirschberg finds just one");
+
+        size_t max_aligned_strlen = strlen(s1) + strlen(s2);
+        char *X = (char *)malloc(max_aligned_strlen + 1);
+        char *Y = (char *)malloc(max_aligned_strlen + 1);
+        check(NULL != X && NULL != Y, "malloc failed");
+
+        int score;
+        int n = hirschberg_align(s1, s2, m, k, d, matrix, X, Y, &score);
+
+        if (qflag != 1 || lflag == 1) {
+                print_aligned_strings_and_counts(stdout, X, Y, n-1,
+                                                 qflag, lflag);
+        }
+
+        if (sflag == 1) {
+                fprintf(stderr, "Optimal score is %-d\n", score);
+                fprintf(stderr, "Aligned in linear space with "
+                        "Hirschberg's algorithm\n");
+        }
+
+        free(X);
+        free(Y);
 }
 
 /*
@@ -642,29 +1514,88 @@ compute_table_scores(computation_t *C)
  *
  *    k - Mismatch penalty, i.e. the amount subtracted from the diagonal
  *        cell's score when it is optimal for the two characters in a
- *        cell to not match.
+ *        cell to not match.  If a substitution matrix was read with -M,
+ *        it scores the diagonal instead, and m and k are unused.
  *
  *    d - Indel penalty, i.e. the amount subtracted from the upper or
  *        left cell's score when it is optimal to skip the character in
- *        the opposite sequence.
+ *        the opposite sequence.  With affine gaps, this is the penalty
+ *        for the first indel of a run.
+ *
+ *    e - Gap extension penalty, i.e. the indel penalty for each indel
+ *        of a run after the first.  Gaps are linear if e equals d.
  *
  *    num_threads - the number of threads to execute in parallel when
  *                  scoring the computation's score table.
  */
 void
-needleman_wunsch(char *s1, char *s2, int m, int k, int d, int num_threads)
+needleman_wunsch(char *s1, char *s2, int m, int k, int d, int e,
+                 int num_threads)
 {
+        check(e == d || xdrop < 0, "-x supports only linear gaps");
+        check(num_samples == 0 || max_alignments == 0, "-k limits the walk "
+              "through every optimal alignment, which -n replaces");
+
+        /* If only the optimal score is wanted, we need neither the
+           alignments nor (usually) the tables */
+        if (oflag == 1) {
+                print_optimal_score(s1, s2, m, k, d, e, num_threads);
+                return;
+        }
+
+        /* With -q alone nothing is printed, so nothing needs to walk
+           the tables: just score the sequences */
+        if (qflag == 1 && lflag != 1 && sflag != 1 && tflag != 1) {
+                optimal_score(s1, s2, m, k, d, e, num_threads, NULL, 0);
+                return;
+        }
+
+        if (algorithm == algo_hirschberg) {
+                align_in_linear_space(s1, s2, m, k, d, e);
+                return;
+        }
+
+        check(tflag != 1 || xdrop < 0, "-t prints every cell of the score "
+              "table, but -x leaves most of them unscored");
+
+        /* Directions derived from the scores need every neighbouring
+           score, and only the plain score of a cell */
+        tables_t tables = keep_walk_table;
+        if (algorithm == algo_scores) {
+                tables = keep_score_table;
+                check(e == d, "-a scores supports only linear gaps");
+                check(xdrop < 0, "-a scores needs every cell of the score "
+                      "table, but -x leaves most of them unscored");
+        } else if (algorithm == algo_checkpoint) {
+                tables = keep_checkpoints;
+                check(e == d, "-a checkpoint supports only linear gaps");
+                check(tflag != 1, "-t needs the score table, "
+                      "which -a checkpoint doesn't keep");
+                check(band < 0 && xdrop < 0, "-b and -x limit the score "
+                      "table, which -a checkpoint doesn't keep");
+                check(num_samples == 0, "-n weighs every cell of the table, "
+                      "which -a checkpoint doesn't keep");
+        }
+
         /* Allocate and initialize computation */
         computation_t *C = alloc_computation();
-        init_computation(C, s1, s2, m, k, d, num_threads);
+        init_computation(C, s1, s2, m, k, d, e, matrix, num_threads, band,
+                         xdrop, tables);
 
         /* Fill out table, i.e. compute the optimal score */
         compute_table_scores(C);
 
+        /* The table printout shows every cell's directions, so build
+           the walk table now if the scores were filled without one */
+        if (tflag == 1 && NULL == C->walk_table) {
+                derive_walk_table(C);
+        }
+
         /* Walk the table.  Mark the optimal path if tflag is set, print
            the aligned strings if qflag is NOT set, and list counts for
-           each alignment if lflag is set */
-        if (qflag != 1 || lflag == 1 || sflag == 1 || tflag == 1) {
+           each alignment if lflag is set.  The summary counts the
+           alignments without the walk, so -q -s skips it. */
+        if (qflag != 1 || lflag == 1 || tflag == 1) {
                 construct_alignments(C);
         }
 
@@ -705,7 +1636,7 @@ int main(int argc, char **argv)
         FILE *in = NULL;
 
         /* Scoring values */
-        int m, k, d;
+        int m, k, d, e;
 
         int num_threads = 1;
 
@@ -720,8 +1651,30 @@ int main(int argc, char **argv)
         extern int optind;
         int c;
 
-        while ((c = getopt(argc, argv, "cf:hlp:qstu")) != -1) {
+        /* Draws for -n differ from run to run unless -r seeds them */
+        sample_seed = (unsigned long)time(NULL);
+
+        while ((c = getopt(argc, argv,
+                           "a:b:cf:hi:k:lM:n:op:qr:stux:")) != -1) {
                 switch (c) {
+                case 'a':
+                        if (strcmp(optarg, "table") == 0) {
+                                algorithm = algo_table;
+                        } else if (strcmp(optarg, "scores") == 0) {
+                                algorithm = algo_scores;
+                        } else if (strcmp(optarg, "checkpoint") == 0) {
+                                algorithm = algo_checkpoint;
+                        } else if (strcmp(optarg, "hirschberg") == 0) {
+                                algorithm = algo_hirschberg;
+                        } else {
+                                sentinel("unknown algorithm %s", optarg);
+                        }
+                        break;
+                case 'b':
+                        band = atoi(optarg);
+                        check(band >= 0, "width == %d; width must be "
+                              "at least 0", band);
+                        break;
                 case 'c':
                         cflag = 1;
                         break;
@@ -731,9 +1684,29 @@ int main(int argc, char **argv)
                 case 'h':
                         usage();
                         break;
+                case 'i':
+                        select_kernels(optarg);
+                        break;
+                case 'k':
+                        max_alignments = atoi(optarg);
+                        check(max_alignments > 0, "max-alignments == %d; "
+                              "max-alignments must be at least 1",
+                              max_alignments);
+                        break;
                 case 'l':
                         lflag = 1;
                         break;
+                case 'M':
+                        matrix = read_substitution_matrix(optarg);
+                        break;
+                case 'n':
+                        num_samples = atoi(optarg);
+                        check(num_samples > 0, "count == %d; count must be "
+                              "at least 1", num_samples);
+                        break;
+                case 'o':
+                        oflag = 1;
+                        break;
                 case 'p':
                         num_threads = atoi(optarg);
                         check(num_threads > 1,
@@ -743,6 +1716,9 @@ int main(int argc, char **argv)
                 case 'q':
                         qflag = 1;
                         break;
+                case 'r':
+                        sample_seed = strtoul(optarg, NULL, 10);
+                        break;
                 case 's':
                         sflag = 1;
                         break;
@@ -752,6 +1728,11 @@ int main(int argc, char **argv)
                 case 'u':
                         uflag = 1;
                         break;
+                case 'x':
+                        xdrop = atoi(optarg);
+                        check(xdrop >= 0, "X == %d; X must be at least 0",
+                              xdrop);
+                        break;
                 case '?':
                 default:
                         usage();
@@ -759,10 +1740,14 @@ int main(int argc, char **argv)
                 }
         }
 
-        /* Make sure we have the right number of operands */
-        if (optind + NUM_OPERANDS != argc) {
-                log_err("expected %d operands but received%s %d", NUM_OPERANDS,
-                        (argc - optind > NUM_OPERANDS ||
+        /* Make sure we have the right number of operands.  A
+           substitution matrix takes the place of m and k. */
+        int min_operands = MIN_OPERANDS - (NULL != matrix ? 2 : 0);
+        int max_operands = MAX_OPERANDS - (NULL != matrix ? 2 : 0);
+        if (optind + min_operands > argc || optind + max_operands < argc) {
+                log_err("expected %d or %d operands but received%s %d",
+                        min_operands, max_operands,
+                        (argc - optind > max_operands ||
                          argc - optind == 0 ? "" : " only"),
                         argc - optind);
                 usage();
@@ -780,16 +1765,29 @@ int main(int argc, char **argv)
         read_two_sequences_from_stream(&s1, &s2, in);
 
         /* Set scoring values to operands give on command-line */
-        m = atoi(argv[optind + 0]);
-        k = atoi(argv[optind + 1]);
-        d = atoi(argv[optind + 2]);
+        m = 0;
+        k = 0;
+        if (NULL == matrix) {
+                m = atoi(argv[optind++]);
+                k = atoi(argv[optind++]);
+        } else {
+                check_matrix_alphabet(matrix, s1);
+                check_matrix_alphabet(matrix, s2);
+        }
+        d = atoi(argv[optind + 0]);
+        e = (optind + 1 < argc ? atoi(argv[optind + 1]) : d);
+        check(e <= d, "e == %d; extending a gap must not cost more than "
+              "opening one (d == %d)", e, d);
 
         /* Solve the alignment */
-        needleman_wunsch(s1, s2, m, k, d, num_threads);
+        needleman_wunsch(s1, s2, m, k, d, e, num_threads);
 
         /* Clean up */
         free(s1);
         free(s2);
+        if (NULL != matrix) {
+                free_substitution_matrix(matrix);
+        }
 
         return 0;
 }
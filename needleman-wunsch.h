@@ -31,39 +31,50 @@
  */
 
 /*
- * needleman-wunsch.h - Global flags for the needleman-wunsch program
- *                      and struct definitions for initial functions
- *                      used in parallel.
+ * needleman-wunsch.h - Global flags for the needleman-wunsch program.
  */
 
 #ifndef __NEEDLEMAN_WUNSCH_H__
 #define __NEEDLEMAN_WUNSCH_H__
 
-#include <pthread.h>
-
 #include "score-table.h"
-
+#include "substitution-matrix.h"
 
 /*
  * Global flags affecting program logic
  */
 
 int lflag = 0;
+int oflag = 0;
 int qflag = 0;
 int sflag = 0;
 int tflag = 0;
 int uflag = 0;
 
-/*
- * Each worker thread has a thread id and a starting column.  The starting
- * column is the first column in the scores table the thread will process.
- * The thread then processes column start_col + num_threads, then
- * start_col + 2*num_threads, etc.
- */
-struct process_col_set_args {
-        int start_col;    /* Column in scores_table to start at */
-        computation_t *C; /* Needleman-Wunsch computation instance to */
-                          /* process columns for */
-};
+/* Half-width of the band of cells to score, set with -b, or -1 */
+int band = -1;
+
+/* X-drop threshold, set with -x, or -1 */
+int xdrop = -1;
+
+/* Most optimal alignments to construct, set with -k, or 0 for all */
+int max_alignments = 0;
+
+/* Number of optimal alignments to draw at random, set with -n, or 0 to
+   construct every one, and the seed of the draws, set with -r */
+int num_samples = 0;
+unsigned long sample_seed = 0;
+
+/* Substitution matrix read with -M, or NULL to score with m and k */
+substitution_matrix_t *matrix = NULL;
+
+/* Algorithm used to construct alignments, selected with -a */
+typedef enum {
+        algo_table,
+        algo_scores,
+        algo_checkpoint,
+        algo_hirschberg
+} algorithm_t;
+algorithm_t algorithm = algo_table;
 
 #endif /* __NEEDLEMAN_WUNSCH_H__ */
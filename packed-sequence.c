@@ -0,0 +1,145 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * packed-sequence.c - Pack nucleotide sequences two bits per base, so
+ *                     the kernels sweeping them keep a quarter of the
+ *                     bytes in cache and test many bases at once.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dbg.h"
+#include "packed-sequence.h"
+
+/* A sequence is packed only if at most one character in this many is an
+ * exception; the exception list then takes no more memory than the
+ * packed bases */
+#define PACKED_BASES_PER_EXCEPTION 64
+
+/*
+ * pack_sequence()
+ *
+ *   Pack the sequence s, or return NULL if too many of its characters
+ *   are not nucleotides (see PACKED_BASES_PER_EXCEPTION) for packing
+ *   to pay.  Lowercase bases are exceptions, since the kernels tell
+ *   them apart from uppercase ones.
+ */
+packed_sequence_t *
+pack_sequence(const char *s)
+{
+        size_t length = strlen(s);
+        size_t num_exceptions = 0;
+        for (size_t i = 0; i < length; i++) {
+                if (nucleotide_code(s[i]) < 0) {
+                        num_exceptions = num_exceptions + 1;
+                }
+        }
+        if (num_exceptions > length / PACKED_BASES_PER_EXCEPTION) {
+                return NULL;
+        }
+
+        packed_sequence_t *P = malloc(sizeof(packed_sequence_t));
+        check(NULL != P, "malloc failed");
+        P->length = length;
+        P->bases = calloc(length / PACKED_BASES_PER_WORD + 2,
+                          sizeof(uint64_t));
+        P->num_exceptions = num_exceptions;
+        P->exceptions = malloc((num_exceptions + 1) *
+                               sizeof(packed_exception_t));
+        check(NULL != P->bases && NULL != P->exceptions, "malloc failed");
+
+        size_t n = 0;
+        for (size_t i = 0; i < length; i++) {
+                int code = nucleotide_code(s[i]);
+                if (code < 0) {
+                        P->exceptions[n].pos = i;
+                        P->exceptions[n].c = s[i];
+                        n = n + 1;
+                        continue;
+                }
+                P->bases[i / PACKED_BASES_PER_WORD] |=
+                        (uint64_t)code << (2 * (i % PACKED_BASES_PER_WORD));
+        }
+
+        return P;
+}
+
+/*
+ * fix_packed_exceptions()
+ *
+ *   Correct the match bits packed_match_bits() computed for the 32
+ *   bases of P from first on, at the exceptions among them: since they
+ *   are coded as A, set their bits only where the exception's
+ *   character is c.
+ */
+uint32_t
+fix_packed_exceptions(const packed_sequence_t *P,
+                      char c,
+                      size_t first,
+                      uint32_t bits)
+{
+        /* Find the first exception at or after first */
+        size_t lo = 0;
+        size_t hi = P->num_exceptions;
+        while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                if (P->exceptions[mid].pos < first) {
+                        lo = mid + 1;
+                } else {
+                        hi = mid;
+                }
+        }
+
+        for (size_t i = lo; i < P->num_exceptions &&
+                     P->exceptions[i].pos < first + PACKED_BASES_PER_WORD;
+             i++) {
+                uint32_t bit = (uint32_t)1 << (P->exceptions[i].pos - first);
+                if (P->exceptions[i].c == c) {
+                        bits = bits | bit;
+                } else {
+                        bits = bits & ~bit;
+                }
+        }
+
+        return bits;
+}
+
+/* Destroy a packed sequence */
+void
+free_packed_sequence(packed_sequence_t *P)
+{
+        free(P->bases);
+        free(P->exceptions);
+        free(P);
+}
@@ -0,0 +1,134 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * packed-sequence.h - Definition of a nucleotide sequence packed two
+ *                     bits per base, and prototypes for the functions
+ *                     implemented in packed-sequence.c.
+ */
+
+#ifndef __PACKED_SEQUENCE_H__
+#define __PACKED_SEQUENCE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Bases per word of a packed sequence */
+#define PACKED_BASES_PER_WORD 32
+
+/* A character of a packed sequence other than A, C, G, or T */
+typedef struct packed_exception {
+        size_t pos;
+        char c;
+} packed_exception_t;
+
+/* packed_sequence_t: A sequence with A, C, G, and T coded as 0 to 3,
+ *                    32 bases to a word, the first base in the lowest
+ *                    two bits.  Any other character is an exception:
+ *                    it is coded as A, and listed with its position in
+ *                    exceptions, in order of position.  A word past the
+ *                    last base lets a window of bases run off the end. */
+typedef struct packed_sequence {
+        size_t length;
+        uint64_t *bases;
+        size_t num_exceptions;
+        packed_exception_t *exceptions;
+} packed_sequence_t;
+
+/* Return the code of nucleotide c, or -1 if c is not one */
+static inline int
+nucleotide_code(char c)
+{
+        switch (c) {
+        case 'A':
+                return 0;
+        case 'C':
+                return 1;
+        case 'G':
+                return 2;
+        case 'T':
+                return 3;
+        default:
+                return -1;
+        }
+}
+
+uint32_t fix_packed_exceptions(const packed_sequence_t *P,
+                               char c,
+                               size_t first,
+                               uint32_t bits);
+
+/*
+ * packed_match_bits()
+ *
+ *   Return a word whose bit i is set if base first + i of P is the
+ *   character c, for i from 0 to 31, testing 32 bases at once.  Bits
+ *   for positions past the end of P are meaningless.
+ */
+static inline uint32_t
+packed_match_bits(const packed_sequence_t *P, char c, size_t first)
+{
+        const uint64_t *w = &P->bases[first / PACKED_BASES_PER_WORD];
+        int shift = 2 * (first % PACKED_BASES_PER_WORD);
+        uint64_t window = w[0] >> shift;
+        if (shift > 0)
+                window |= w[1] << (64 - shift);
+
+        /* A base matches if both of its bits agree with c's code.  The
+           match bits land on even bit positions; gather them into the
+           low 32 bits. */
+        uint64_t bits = 0;
+        int code = nucleotide_code(c);
+        if (code >= 0) {
+                uint64_t x = window ^ (0x5555555555555555ULL * code);
+                bits = ~(x | x >> 1) & 0x5555555555555555ULL;
+                bits = (bits | bits >> 1) & 0x3333333333333333ULL;
+                bits = (bits | bits >> 2) & 0x0F0F0F0F0F0F0F0FULL;
+                bits = (bits | bits >> 4) & 0x00FF00FF00FF00FFULL;
+                bits = (bits | bits >> 8) & 0x0000FFFF0000FFFFULL;
+                bits = (bits | bits >> 16) & 0x00000000FFFFFFFFULL;
+        }
+
+        if (P->num_exceptions > 0)
+                return fix_packed_exceptions(P, c, first, bits);
+        return bits;
+}
+
+/*
+ * Prototypes
+ */
+
+packed_sequence_t *pack_sequence(const char *s);
+
+void free_packed_sequence(packed_sequence_t *P);
+
+#endif /* __PACKED_SEQUENCE_H__ */
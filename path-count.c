@@ -0,0 +1,449 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * path-count.c - Counting the optimal alignments of a scored
+ *                computation without enumerating them.  The optimal
+ *                directions form a DAG over the cells of the table
+ *                (with affine gaps, over the three layers of each
+ *                cell), and each optimal alignment is one path through
+ *                it from the bottom-right cell to the top-left one.  We
+ *                sweep the table once from the bottom-right, pushing
+ *                the number of paths reaching each cell on to the cells
+ *                its directions lead to, and keep two columns of
+ *                counts.
+ *
+ *                To draw alignments at random (see -n), we need the
+ *                number of paths from the top-left cell to every cell
+ *                instead, kept whole, as logarithms.  To split a walk
+ *                of the table between threads (see -p and -k), we
+ *                need exact counts to a few cells, which one sweep from
+ *                the top-left pulling counts along the directions
+ *                gives.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "checkpoint.h"
+#include "computation.h"
+#include "dbg.h"
+#include "path-count.h"
+#include "score-table.h"
+#include "walk-table.h"
+
+/*
+ * column_rows()
+ *
+ *   Set *first and *last to the first and last row of column col of a
+ *   computation's table that can be on an optimal path.
+ */
+static void
+column_rows(computation_t *C, int N, int col, int *first, int *last)
+{
+        *first = 0;
+        *last = N - 1;
+        if (NULL != C->score_table) {
+                *first = score_table_first_row(C->score_table, col);
+                *last = score_table_last_row(C->score_table, col);
+        }
+}
+
+/*
+ * count_alignments()
+ *
+ *   Return the number of optimal alignments of a scored computation,
+ *   or PATH_COUNT_MAX if there are at least that many.  Since the sweep
+ *   reaches exactly the cells on some optimal alignment, it also notes
+ *   whether one touches the edge of the computation's band.
+ *
+ *   C - scored computation instance
+ */
+path_count_t
+count_alignments(computation_t *C)
+{
+        int affine = C->gap_extend_penalty != C->indel_penalty;
+        int M, N;
+        if (NULL != C->checkpoints) {
+                M = C->checkpoints->M;
+                N = C->checkpoints->N;
+        } else {
+                M = C->score_table->M;
+                N = C->score_table->N;
+        }
+
+        /* Paths reaching each cell of the current column and of the
+           column to its left, and with affine gaps, paths reaching the
+           left gap layer of each.  The up gap layer is carried up the
+           column. */
+        path_count_t *this = (path_count_t *)calloc(N, sizeof(path_count_t));
+        path_count_t *prev = (path_count_t *)calloc(N, sizeof(path_count_t));
+        path_count_t *left_this = NULL;
+        path_count_t *left_prev = NULL;
+        check(NULL != this && NULL != prev, "calloc failed");
+        if (affine) {
+                left_this = (path_count_t *)calloc(N, sizeof(path_count_t));
+                left_prev = (path_count_t *)calloc(N, sizeof(path_count_t));
+                check(NULL != left_this && NULL != left_prev,
+                      "calloc failed");
+        }
+
+        path_count_t total = 0;
+        this[N-1] = 1;
+
+        for (int col = M - 1; col >= 0; col--) {
+                int first, last;
+                column_rows(C, N, col, &first, &last);
+                path_count_t up = 0;
+
+                for (int row = last; row >= first; row--) {
+                        path_count_t n = this[row];
+                        path_count_t left = affine ? left_this[row] : 0;
+                        if (n == 0 && left == 0 && up == 0) {
+                                continue;
+                        }
+
+                        if (C->band >= 0 &&
+                            score_table_on_band_edge(C->score_table, col,
+                                                     row)) {
+                                C->touched_band_edge = 1;
+                        }
+                        if (col == 0 && row == 0) {
+                                total = n;
+                                continue;
+                        }
+
+                        walk_table_cell_t dirs =
+                                get_walk_directions(C, col, row);
+
+                        if (!affine) {
+                                if (dirs & walk_diag)
+                                        prev[row-1] =
+                                                path_count_add(prev[row-1], n);
+                                if (dirs & walk_left)
+                                        prev[row] =
+                                                path_count_add(prev[row], n);
+                                if (dirs & walk_up)
+                                        this[row-1] =
+                                                path_count_add(this[row-1], n);
+                                continue;
+                        }
+
+                        /* With affine gaps, the cell's paths go on
+                           diagonally or into its gap layers, and the
+                           paths in a gap layer go on from the
+                           neighbouring cell or its gap */
+                        if (dirs & walk_diag)
+                                prev[row-1] = path_count_add(prev[row-1], n);
+                        if (dirs & walk_left)
+                                left = path_count_add(left, n);
+                        if (dirs & walk_up)
+                                up = path_count_add(up, n);
+
+                        if (dirs & left_gap_open)
+                                prev[row] = path_count_add(prev[row], left);
+                        if (dirs & left_gap_extend)
+                                left_prev[row] =
+                                        path_count_add(left_prev[row], left);
+
+                        if (dirs & up_gap_open)
+                                this[row-1] = path_count_add(this[row-1], up);
+                        up = (dirs & up_gap_extend) ? up : 0;
+                }
+
+                /* Clear the column's counts so that the array can hold
+                   the counts of the column two to the left */
+                for (int row = first; row <= last; row++) {
+                        this[row] = 0;
+                        if (affine) {
+                                left_this[row] = 0;
+                        }
+                }
+
+                path_count_t *swap = this;
+                this = prev;
+                prev = swap;
+                if (affine) {
+                        swap = left_this;
+                        left_this = left_prev;
+                        left_prev = swap;
+                }
+        }
+
+        free(this);
+        free(prev);
+        free(left_this);
+        free(left_prev);
+        return total;
+}
+
+/*
+ * count_paths_to_cells()
+ *
+ *   Set counts[c] to the number of optimal paths from the top-left
+ *   cell of a scored computation's table to cell (cols[c], rows[c]),
+ *   or PATH_COUNT_MAX if there are at least that many.  This is how
+ *   many alignments a walk of the table from the cell constructs.  The
+ *   computation must score gaps linearly.
+ *
+ *   C - scored computation instance
+ *
+ *   num_cells - number of cells to count the paths to
+ *
+ *   cols, rows - the cells' columns and rows
+ *
+ *   counts - where to store the counts
+ */
+void
+count_paths_to_cells(computation_t *C,
+                     int num_cells,
+                     const int *cols,
+                     const int *rows,
+                     path_count_t *counts)
+{
+        int M, N;
+        if (NULL != C->checkpoints) {
+                M = C->checkpoints->M;
+                N = C->checkpoints->N;
+        } else {
+                M = C->score_table->M;
+                N = C->score_table->N;
+        }
+
+        /* Paths to each cell of the current column and of the column
+           to its left.  Rows outside a column's band hold 0. */
+        path_count_t *this = (path_count_t *)calloc(N, sizeof(path_count_t));
+        path_count_t *prev = (path_count_t *)calloc(N, sizeof(path_count_t));
+        check(NULL != this && NULL != prev, "calloc failed");
+
+        /* Rows of the column two to the left, still held in this */
+        int stale_first = 0;
+        int stale_last = -1;
+        int prev_first = 0;
+        int prev_last = -1;
+
+        for (int col = 0; col < M; col++) {
+                int first, last;
+                column_rows(C, N, col, &first, &last);
+                for (int row = stale_first; row <= stale_last; row++) {
+                        this[row] = 0;
+                }
+
+                for (int row = first; row <= last; row++) {
+                        if (col == 0 && row == 0) {
+                                this[row] = 1;
+                                continue;
+                        }
+
+                        walk_table_cell_t dirs =
+                                get_walk_directions(C, col, row);
+                        path_count_t n = 0;
+                        if (dirs & walk_diag)
+                                n = path_count_add(n, prev[row-1]);
+                        if (dirs & walk_left)
+                                n = path_count_add(n, prev[row]);
+                        if (dirs & walk_up && row > first)
+                                n = path_count_add(n, this[row-1]);
+                        this[row] = n;
+                }
+
+                for (int c = 0; c < num_cells; c++) {
+                        if (cols[c] == col) {
+                                counts[c] = (rows[c] >= first &&
+                                             rows[c] <= last ?
+                                             this[rows[c]] : 0);
+                        }
+                }
+
+                path_count_t *swap = this;
+                this = prev;
+                prev = swap;
+                stale_first = prev_first;
+                stale_last = prev_last;
+                prev_first = first;
+                prev_last = last;
+        }
+
+        free(this);
+        free(prev);
+}
+
+/*
+ * format_path_count()
+ *
+ *   Write n in decimal to buf, which must hold PATH_COUNT_DIGITS
+ *   characters, and return a pointer to the first digit.
+ */
+char *
+format_path_count(path_count_t n, char *buf)
+{
+        char *p = buf + PATH_COUNT_DIGITS - 1;
+        *p = '\0';
+        do {
+                p = p - 1;
+                *p = '0' + (int)(n % 10);
+                n = n / 10;
+        } while (n != 0);
+        return p;
+}
+
+/* Return log2(2^a + 2^b) */
+static inline double
+log2_add(double a, double b)
+{
+        if (a < b) {
+                double swap = a;
+                a = b;
+                b = swap;
+        }
+        if (b == -INFINITY) {
+                return a;
+        }
+        return a + log1p(exp2(b - a)) / M_LN2;
+}
+
+/*
+ * weigh_paths()
+ *
+ *   Return the path weights of a scored computation, filled in one
+ *   sweep of its table from the top-left cell.
+ *
+ *   C - scored computation instance
+ */
+path_weights_t *
+weigh_paths(computation_t *C)
+{
+        int affine = C->gap_extend_penalty != C->indel_penalty;
+        path_weights_t *P = (path_weights_t *)malloc(sizeof(path_weights_t));
+        check(NULL != P, "malloc failed");
+
+        size_t column_size;
+        if (NULL != C->checkpoints) {
+                P->M = C->checkpoints->M;
+                P->N = C->checkpoints->N;
+                P->column_step = P->N;
+                P->column_skew = 0;
+                column_size = P->N;
+        } else {
+                P->M = C->score_table->M;
+                P->N = C->score_table->N;
+                P->column_step = C->score_table->column_step;
+                P->column_skew = C->score_table->column_skew;
+                column_size = C->score_table->band < 0 ? (size_t)P->N :
+                        2 * (size_t)C->score_table->band + 3;
+        }
+
+        /* Cells off every path, including those bordering a band, keep
+           a weight of -infinity */
+        size_t size = (size_t)P->M * column_size;
+        P->cells = (double *)malloc(size * sizeof(double));
+        check(NULL != P->cells, "malloc failed");
+        P->left_gaps = NULL;
+        P->up_gaps = NULL;
+        if (affine) {
+                P->left_gaps = (double *)malloc(size * sizeof(double));
+                P->up_gaps = (double *)malloc(size * sizeof(double));
+                check(NULL != P->left_gaps && NULL != P->up_gaps,
+                      "malloc failed");
+        }
+        for (size_t i = 0; i < size; i++) {
+                P->cells[i] = -INFINITY;
+                if (affine) {
+                        P->left_gaps[i] = -INFINITY;
+                        P->up_gaps[i] = -INFINITY;
+                }
+        }
+
+        for (int col = 0; col < P->M; col++) {
+                int first, last;
+                column_rows(C, P->N, col, &first, &last);
+
+                for (int row = first; row <= last; row++) {
+                        double *w = path_weight(P, P->cells, col, row);
+                        if (col == 0 && row == 0) {
+                                *w = 0;
+                                continue;
+                        }
+
+                        walk_table_cell_t dirs =
+                                get_walk_directions(C, col, row);
+                        double diag = (dirs & walk_diag) ?
+                                *path_weight(P, P->cells, col-1, row-1) :
+                                -INFINITY;
+
+                        if (!affine) {
+                                double left = (dirs & walk_left) ?
+                                        *path_weight(P, P->cells, col-1,
+                                                     row) : -INFINITY;
+                                double up = (dirs & walk_up) ?
+                                        *path_weight(P, P->cells, col,
+                                                     row-1) : -INFINITY;
+                                *w = log2_add(diag, log2_add(left, up));
+                                continue;
+                        }
+
+                        /* With affine gaps, weigh the gap layers, which
+                           go on from the neighbouring cell or its gap,
+                           and then the cell */
+                        double *left = path_weight(P, P->left_gaps, col,
+                                                   row);
+                        double *up = path_weight(P, P->up_gaps, col, row);
+                        if (dirs & left_gap_open)
+                                *left = log2_add(*left, *path_weight(
+                                        P, P->cells, col-1, row));
+                        if (dirs & left_gap_extend)
+                                *left = log2_add(*left, *path_weight(
+                                        P, P->left_gaps, col-1, row));
+                        if (dirs & up_gap_open)
+                                *up = log2_add(*up, *path_weight(
+                                        P, P->cells, col, row-1));
+                        if (dirs & up_gap_extend)
+                                *up = log2_add(*up, *path_weight(
+                                        P, P->up_gaps, col, row-1));
+
+                        *w = log2_add(diag, log2_add(
+                                (dirs & walk_left) ? *left : -INFINITY,
+                                (dirs & walk_up) ? *up : -INFINITY));
+                }
+        }
+
+        return P;
+}
+
+void
+free_path_weights(path_weights_t *P)
+{
+        free(P->cells);
+        free(P->left_gaps);
+        free(P->up_gaps);
+        free(P);
+}
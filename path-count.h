@@ -0,0 +1,103 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * path-count.h - Prototypes for counting the optimal alignments of a
+ *                scored computation, implemented in path-count.c.
+ */
+
+#ifndef __PATH_COUNT_H__
+#define __PATH_COUNT_H__
+
+#include "computation.h"
+
+/* path_count_t: A count of optimal alignments.  Counts saturate at
+ *               PATH_COUNT_MAX rather than wrapping. */
+typedef unsigned __int128 path_count_t;
+
+#define PATH_COUNT_MAX ((path_count_t)-1)
+
+/* Characters needed to print any path_count_t in decimal, with the
+   terminating NUL */
+#define PATH_COUNT_DIGITS 40
+
+/* Return a + b, or PATH_COUNT_MAX if the sum doesn't fit */
+static inline path_count_t
+path_count_add(path_count_t a, path_count_t b)
+{
+        return a + b < a ? PATH_COUNT_MAX : a + b;
+}
+
+/* path_weights_t: For each cell of a computation's table, and with
+ *                 affine gaps each of its gap layers, the base-2
+ *                 logarithm of the number of optimal paths from the
+ *                 top-left cell to it, or -INFINITY if there are none.
+ *                 Logarithms never overflow, however many paths there
+ *                 are.  The cells are laid out like the computation's
+ *                 score table (see score-table.h). */
+typedef struct path_weights {
+        int M;
+        int N;
+        size_t column_step;
+        size_t column_skew;
+        double *cells;
+        double *left_gaps;      /* NULL with linear gaps */
+        double *up_gaps;        /* NULL with linear gaps */
+} path_weights_t;
+
+/* Return a pointer to the weight at (col, row) of the layer of
+   weights */
+static inline double *
+path_weight(const path_weights_t *P, double *layer, int col, int row)
+{
+        return &layer[(size_t)col * P->column_step + P->column_skew + row];
+}
+
+/*
+ * Prototypes
+ */
+
+path_count_t count_alignments(computation_t *C);
+
+void count_paths_to_cells(computation_t *C,
+                          int num_cells,
+                          const int *cols,
+                          const int *rows,
+                          path_count_t *counts);
+
+char *format_path_count(path_count_t n, char *buf);
+
+path_weights_t *weigh_paths(computation_t *C);
+
+void free_path_weights(path_weights_t *P);
+
+#endif /* __PATH_COUNT_H__ */
@@ -37,6 +37,8 @@
  *                 Needleman-Wunsch algorithm.
  */
 
+#include <stdlib.h>
+
 #include "dbg.h"
 #include "format.h"
 #include "print-table.h"
@@ -86,7 +88,8 @@ print_arrow(arrow_t a, int optimal_path, int col_width, int col, int row, char *
 }
 
 static void
-print_directional_row(walk_table_t *W,
+print_directional_row(score_table_t *S,
+                      walk_table_t *W,
                       int row,
                       char *s1,
                       char *s2,
@@ -96,19 +99,26 @@ print_directional_row(walk_table_t *W,
         // Start with a space as a character placeholder
         printf(" ");
 
-        // Print the row's directional arrows
+        // Print the row's directional arrows.  Cells outside the band
+        // of a banded table are left blank.
         for (int col = 0; col < W->M; col++) {
-                int optimal_path = W->cells[col][row].in_optimal_path;
+                if (!score_table_has_cell(S, col, row)) {
+                        printf("    %*s", col_width, "");
+                        continue;
+                }
+
+                walk_table_cell_t cell = *walk_table_cell(W, col, row);
+                int optimal_path = (cell & walk_optimal) != 0;
 
                 /* Print diagonal arrow if applicable */
-                if (W->cells[col][row].diag == 1) {
+                if (cell & walk_diag) {
                         print_arrow(diag, optimal_path, col_width, col, row, s1, s2, unicode);
                 } else {
                         printf("    ");
                 }
 
                 /* Print up arrow if applicable */
-                if (W->cells[col][row].up == 1) {
+                if (cell & walk_up) {
                         print_arrow(up, optimal_path, col_width, col, row, s1, s2, unicode);
                 } else {
                         printf("%*s", col_width, "");
@@ -135,10 +145,16 @@ print_score_row(score_table_t *S,
 
         // Now print the scores and left arrows
         for (int col = 0; col < S->M; col++) {
-                int optimal_path = W->cells[col][row].in_optimal_path;
+                if (!score_table_has_cell(S, col, row)) {
+                        printf("    %*s", col_width, "");
+                        continue;
+                }
+
+                walk_table_cell_t cell = *walk_table_cell(W, col, row);
+                int optimal_path = (cell & walk_optimal) != 0;
 
                 /* Print left arrow if applicable */
-                if (W->cells[col][row].left == 1) {
+                if (cell & walk_left) {
                         print_arrow(left, optimal_path, col_width, col, row, s1, s2, unicode);
                 } else {
                         printf("    ");
@@ -148,7 +164,7 @@ print_score_row(score_table_t *S,
                 if (optimal_path == 1) {
                         set_fmt(opt_path_fmt);
                 }
-                printf("%+*d", col_width, S->cells[col][row].score);
+                printf("%+*d", col_width, score_table_get(S, col, row));
                 if (optimal_path == 1) {
                         reset_fmt();
                 }
@@ -165,7 +181,7 @@ print_table_row(score_table_t *S,
                 int col_width,
                 int unicode)
 {
-        print_directional_row(W, row, s1, s2, col_width, unicode);
+        print_directional_row(S, W, row, s1, s2, col_width, unicode);
         print_score_row(S, W, row, s1, s2, col_width, unicode);
 }
 
@@ -192,10 +208,27 @@ width_needed_to_print_integer(int x)
         return w + 1; /* add 1 to make room for a positive/negative sign */
 }
 
+static int
+greatest_abs_score(score_table_t *S)
+{
+        int greatest = 0;
+        for (int col = 0; col < S->M; col++) {
+                int *scores = score_table_column(S, col);
+                int last_row = score_table_last_row(S, col);
+                for (int row = score_table_first_row(S, col);
+                     row <= last_row; row++) {
+                        if (abs(scores[row]) > greatest) {
+                                greatest = abs(scores[row]);
+                        }
+                }
+        }
+        return greatest;
+}
+
 void
 print_table(score_table_t *S, walk_table_t *W, char *s1, char *s2, int unicode)
 {
-        int col_width = width_needed_to_print_integer(S->greatest_abs_val);
+        int col_width = width_needed_to_print_integer(greatest_abs_score(S));
 
         /* Print the top string, i.e. the first input string. */
         print_top_string(S, s1, col_width);
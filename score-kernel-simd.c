@@ -0,0 +1,416 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * score-kernel-simd.c - SIMD column kernel for the Needleman-Wunsch
+ *                       score table.  This file is compiled once per
+ *                       vector extension (see simd.h and the Makefile);
+ *                       each build defines score_cell_column_<isa>(),
+ *                       and param_kernels_<isa> for the parameter sets
+ *                       in PARAMS.
+ */
+
+#include <stdint.h>
+
+#include "computation.h"
+#include "packed-sequence.h"
+#include "score-kernel.h"
+#include "score-table.h"
+#include "simd.h"
+#include "walk-table.h"
+
+#ifdef SIMD_LANES
+
+/*
+ * score_column_simd_with()
+ *
+ *   Write alignment scores to a run of cells in one column of a
+ *   computation's score table, SIMD_LANES rows at a time, scoring with
+ *   match bonus m, mismatch penalty k, and indel penalty d, or with the
+ *   query profile in place of m and k if profiled is nonzero.  Scores
+ *   and walk table directions are exactly those score_cell_column()
+ *   or score_cell_column_profile() would write.
+ *
+ *   Within a block of rows, the diagonal and left candidates depend
+ *   only on the column to the left and are computed for every lane at
+ *   once.  The up candidate chains each row to the one above; we
+ *   resolve the chain with a log-step prefix max, in which a lane
+ *   inherits the best score of the lane n rows above less n indels,
+ *   then fold in the last score of the block above.
+ *
+ *     C - pointer to the computation instance containing the target
+ *         score table
+ *
+ *   col - index of the column of cells to score
+ *
+ *   first_row - first row of the run
+ *
+ *   last_row - last row of the run
+ *
+ *   m, k, d - scoring parameters
+ *
+ *   profiled - nonzero to score with the query profile
+ */
+static inline __attribute__((always_inline)) void
+score_column_simd_with(computation_t *C,
+                       int col,
+                       int first_row,
+                       int last_row,
+                       int m,
+                       int k,
+                       int d,
+                       int profiled)
+{
+        score_table_t *S = C->score_table;
+        walk_table_t *W = C->walk_table;
+        const int *prev = score_table_column(S, col - 1);
+        int *this = score_table_column(S, col);
+
+        const vint_t ninf = v_set1(SIMD_NEG_INF);
+        const vint_t vd = v_set1(d);
+        const vint_t vd2 = v_set1(2 * d);
+#if SIMD_LANES > 4
+        const vint_t vd4 = v_set1(4 * d);
+#endif
+#if SIMD_LANES > 8
+        const vint_t vd8 = v_set1(8 * d);
+#endif
+        const vint_t steps = v_steps(d);
+        const vint_t match = v_set1(m);
+        const vint_t mismatch = v_set1(-k);
+        const vint_t top = v_set1((unsigned char)C->top_string[col-1]);
+        const int *bonus = profiled ?
+                query_profile_row(C->matrix, C->query_profile, S->N - 1,
+                                  C->top_string[col-1]) : NULL;
+        const packed_sequence_t *packed = profiled ? NULL : C->packed_side;
+        uint32_t match_bits = 0;
+
+        /* Score of the cell above the current block */
+        int carry = this[first_row-1];
+
+        int row;
+        for (row = first_row; row + SIMD_LANES - 1 <= last_row;
+             row += SIMD_LANES) {
+                vint_t diag = v_loadu(prev + row - 1);
+                vint_t left = v_sub(v_loadu(prev + row), vd);
+                if (profiled) {
+                        diag = v_add(diag, v_loadu(bonus + row));
+                } else if (NULL != packed) {
+                        /* The bases of 32 rows are tested at a time,
+                           and SIMD_LANES divides 32 */
+                        if ((row - first_row) % PACKED_BASES_PER_WORD == 0) {
+                                match_bits = packed_match_bits(
+                                        packed, C->top_string[col-1],
+                                        row - 1);
+                        }
+                        diag = v_add(diag, v_blendv(mismatch, match,
+                                                    v_bits_mask(match_bits)));
+                        match_bits = match_bits >> SIMD_LANES;
+                } else {
+                        vint_t side = v_load_chars(C->side_string + row - 1);
+                        diag = v_add(diag, v_blendv(mismatch, match,
+                                                    v_cmpeq(side, top)));
+                }
+
+                /* Best of diagonal and left, then the up chain within
+                   the block, then the up chain from above it */
+                vint_t h = v_max(diag, left);
+                h = v_max(h, v_sub(v_shift1(h, ninf), vd));
+                h = v_max(h, v_sub(v_shift2(h, ninf), vd2));
+#if SIMD_LANES > 4
+                h = v_max(h, v_sub(v_shift4(h, ninf), vd4));
+#endif
+#if SIMD_LANES > 8
+                h = v_max(h, v_sub(v_shift8(h, ninf), vd8));
+#endif
+                h = v_max(h, v_sub(v_set1(carry), steps));
+                v_storeu(this + row, h);
+
+                /* Without a walk table there are no directions to
+                   mark */
+                if (NULL != W) {
+                        vint_t up = v_sub(v_shift1(h, v_set1(carry)), vd);
+                        int diag_mask = v_movemask(v_cmpeq(h, diag));
+                        int up_mask = v_movemask(v_cmpeq(h, up));
+                        int left_mask = v_movemask(v_cmpeq(h, left));
+
+                        for (int i = 0; i < SIMD_LANES; i++) {
+                                mark_walk_cell(W, col, row + i,
+                                               (diag_mask >> i) & 1,
+                                               (up_mask >> i) & 1,
+                                               (left_mask >> i) & 1);
+                        }
+                }
+
+                carry = v_last(h);
+        }
+
+        /* Rows left over after the last full block */
+        score_column_with(C, col, row, last_row, m, k, d, profiled);
+}
+
+/*
+ * score_cell_column_<isa>()
+ *
+ *   The SIMD column kernel, scoring with the computation's parameters.
+ *   See score_column_simd_with().
+ */
+void
+SIMD_FN(score_cell_column)(computation_t *C,
+                           int col,
+                           int first_row,
+                           int last_row)
+{
+        score_column_simd_with(C, col, first_row, last_row, C->match_score,
+                               C->mismatch_penalty, C->indel_penalty, 0);
+}
+
+/*
+ * score_cell_column_profile_<isa>()
+ *
+ *   The SIMD column kernel for scoring with a substitution matrix.  See
+ *   score_column_simd_with().
+ */
+void
+SIMD_FN(score_cell_column_profile)(computation_t *C,
+                                   int col,
+                                   int first_row,
+                                   int last_row)
+{
+        score_column_simd_with(C, col, first_row, last_row, 0, 0,
+                               C->indel_penalty, 1);
+}
+
+/*
+ * score_column_affine_simd_with()
+ *
+ *   Write alignment scores to a run of cells in one column with affine
+ *   gaps, SIMD_LANES rows at a time.  Scores and walk table directions
+ *   are exactly those score_cell_column_affine() would write, provided
+ *   that extending a gap costs no more than opening one (e <= d).
+ *
+ *   Left gaps and the diagonal depend only on the column to the left.
+ *   Up gaps chain down the block, but since e <= d, reopening a gap
+ *   right after an up gap never beats extending it, so an up gap at a
+ *   lane either extends the one above or opens after the best diagonal
+ *   or left gap score of some lane above.  That is a prefix max with
+ *   step e, much like the up chain of score_column_simd_with().
+ *   profiled is as for score_column_simd_with().
+ */
+static inline __attribute__((always_inline)) void
+score_column_affine_simd_with(computation_t *C,
+                              int col,
+                              int first_row,
+                              int last_row,
+                              int m,
+                              int k,
+                              int d,
+                              int e,
+                              int profiled)
+{
+        score_table_t *S = C->score_table;
+        walk_table_t *W = C->walk_table;
+        const int *prev = score_table_column(S, col - 1);
+        int *this = score_table_column(S, col);
+        int *left_gap = C->left_gap_scores;
+
+        const vint_t ninf = v_set1(SIMD_NEG_INF);
+        const vint_t vd = v_set1(d);
+        const vint_t ve = v_set1(e);
+        const vint_t ve2 = v_set1(2 * e);
+#if SIMD_LANES > 4
+        const vint_t ve4 = v_set1(4 * e);
+#endif
+#if SIMD_LANES > 8
+        const vint_t ve8 = v_set1(8 * e);
+#endif
+        const vint_t match = v_set1(m);
+        const vint_t mismatch = v_set1(-k);
+        const vint_t top = v_set1((unsigned char)C->top_string[col-1]);
+        const int *bonus = profiled ?
+                query_profile_row(C->matrix, C->query_profile, S->N - 1,
+                                  C->top_string[col-1]) : NULL;
+        const packed_sequence_t *packed = profiled ? NULL : C->packed_side;
+        uint32_t match_bits = 0;
+
+        /* Score of the cell above the current block, and of the best
+           alignment ending there in an up gap */
+        int carry = this[first_row-1];
+        int up_carry = C->up_gap_scores[col];
+
+        int row;
+        for (row = first_row; row + SIMD_LANES - 1 <= last_row;
+             row += SIMD_LANES) {
+                vint_t left_open = v_sub(v_loadu(prev + row), vd);
+                vint_t left_extend = v_sub(v_loadu(left_gap + row), ve);
+                vint_t left = v_max(left_open, left_extend);
+                vint_t diag = v_loadu(prev + row - 1);
+                if (profiled) {
+                        diag = v_add(diag, v_loadu(bonus + row));
+                } else if (NULL != packed) {
+                        /* The bases of 32 rows are tested at a time,
+                           and SIMD_LANES divides 32 */
+                        if ((row - first_row) % PACKED_BASES_PER_WORD == 0) {
+                                match_bits = packed_match_bits(
+                                        packed, C->top_string[col-1],
+                                        row - 1);
+                        }
+                        diag = v_add(diag, v_blendv(mismatch, match,
+                                                    v_bits_mask(match_bits)));
+                        match_bits = match_bits >> SIMD_LANES;
+                } else {
+                        vint_t side = v_load_chars(C->side_string + row - 1);
+                        diag = v_add(diag, v_blendv(mismatch, match,
+                                                    v_cmpeq(side, top)));
+                }
+
+                /* Up gaps: the first lane's comes from the cell above
+                   the block; each later lane's opens after the best
+                   non-gap or left gap score of the lane above, or
+                   extends an up gap from further above */
+                vint_t h = v_max(diag, left);
+                int up_first = carry - d > up_carry - e ?
+                        carry - d : up_carry - e;
+                vint_t up = v_shift1(v_sub(h, vd), v_set1(up_first));
+                up = v_max(up, v_sub(v_shift1(up, ninf), ve));
+                up = v_max(up, v_sub(v_shift2(up, ninf), ve2));
+#if SIMD_LANES > 4
+                up = v_max(up, v_sub(v_shift4(up, ninf), ve4));
+#endif
+#if SIMD_LANES > 8
+                up = v_max(up, v_sub(v_shift8(up, ninf), ve8));
+#endif
+                h = v_max(h, up);
+                v_storeu(this + row, h);
+                v_storeu(left_gap + row, left);
+
+                if (NULL != W) {
+                        vint_t up_open =
+                                v_sub(v_shift1(h, v_set1(carry)), vd);
+                        vint_t up_extend =
+                                v_sub(v_shift1(up, v_set1(up_carry)), ve);
+                        int diag_mask = v_movemask(v_cmpeq(h, diag));
+                        int up_mask = v_movemask(v_cmpeq(h, up));
+                        int left_mask = v_movemask(v_cmpeq(h, left));
+                        int left_open_mask =
+                                v_movemask(v_cmpeq(left, left_open));
+                        int left_extend_mask =
+                                v_movemask(v_cmpeq(left, left_extend));
+                        int up_open_mask =
+                                v_movemask(v_cmpeq(up, up_open));
+                        int up_extend_mask =
+                                v_movemask(v_cmpeq(up, up_extend));
+
+                        for (int i = 0; i < SIMD_LANES; i++) {
+                                mark_affine_walk_cell(
+                                        W, col, row + i,
+                                        (diag_mask >> i) & 1,
+                                        (up_mask >> i) & 1,
+                                        (left_mask >> i) & 1,
+                                        (((left_open_mask >> i) & 1) ?
+                                         left_gap_open : 0) |
+                                        (((left_extend_mask >> i) & 1) ?
+                                         left_gap_extend : 0) |
+                                        (((up_open_mask >> i) & 1) ?
+                                         up_gap_open : 0) |
+                                        (((up_extend_mask >> i) & 1) ?
+                                         up_gap_extend : 0));
+                        }
+                }
+
+                carry = v_last(h);
+                up_carry = v_last(up);
+        }
+
+        /* Rows left over after the last full block */
+        C->up_gap_scores[col] = up_carry;
+        score_column_affine_with(C, col, row, last_row, m, k, d, e,
+                                 profiled);
+}
+
+/*
+ * score_cell_column_affine_<isa>()
+ *
+ *   The SIMD column kernel for affine gaps.  See
+ *   score_column_affine_simd_with().
+ */
+void
+SIMD_FN(score_cell_column_affine)(computation_t *C,
+                                  int col,
+                                  int first_row,
+                                  int last_row)
+{
+        score_column_affine_simd_with(C, col, first_row, last_row,
+                                      C->match_score, C->mismatch_penalty,
+                                      C->indel_penalty,
+                                      C->gap_extend_penalty, 0);
+}
+
+/*
+ * score_cell_column_affine_profile_<isa>()
+ *
+ *   The SIMD column kernel for affine gaps and a substitution matrix.
+ *   See score_column_affine_simd_with().
+ */
+void
+SIMD_FN(score_cell_column_affine_profile)(computation_t *C,
+                                          int col,
+                                          int first_row,
+                                          int last_row)
+{
+        score_column_affine_simd_with(C, col, first_row, last_row, 0, 0,
+                                      C->indel_penalty,
+                                      C->gap_extend_penalty, 1);
+}
+
+/* One SIMD column kernel per parameter set in score-params.h */
+#define PARAM_SET(id, m, k, d)                                          \
+        static void                                                     \
+        score_cell_column_##id(computation_t *C,                        \
+                               int col,                                 \
+                               int first_row,                           \
+                               int last_row)                            \
+        {                                                               \
+                score_column_simd_with(C, col, first_row, last_row,     \
+                                       m, k, d, 0);                     \
+        }
+#include "score-params.h"
+#undef PARAM_SET
+
+const param_kernel_t SIMD_FN(param_kernels)[] = {
+#define PARAM_SET(id, m, k, d) { m, k, d, score_cell_column_##id },
+#include "score-params.h"
+#undef PARAM_SET
+        { 0, 0, 0, NULL }
+};
+
+#endif /* SIMD_LANES */
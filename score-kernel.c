@@ -0,0 +1,551 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * score-kernel.c - Scalar column kernels for the Needleman-Wunsch score
+ *                  table.  score_cell_column() scores one cell at a
+ *                  time; it is the generic kernel.  It is also built
+ *                  once for each parameter set in PARAMS (see the
+ *                  Makefile), with the parameters as constants.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "computation.h"
+#include "dbg.h"
+#include "packed-sequence.h"
+#include "score-kernel.h"
+#include "score-table.h"
+#include "walk-table.h"
+
+/*
+ * score_cell()
+ *
+ *   Write the alignment score to the score_table cell at (col,row).
+ *
+ *   C - pointer to computation_t instance containing the target
+ *       score_table
+ *
+ *   col - column of the target cell in the score table
+ *
+ *   row - row of the target cell in the score table
+ */
+void
+score_cell(computation_t *C, int col, int row)
+{
+        score_column_with(C, col, row, row, C->match_score,
+                          C->mismatch_penalty, C->indel_penalty,
+                          NULL != C->matrix);
+}
+
+/*
+ * derive_walk_cell()
+ *
+ *   Return the walk table cell score_cell() would have written for
+ *   (col, row) of a computation with linear gaps, derived from the
+ *   scores around it: a direction is optimal exactly when the score it
+ *   comes from, less the cost of the step, is the cell's score.  The
+ *   cells bordering a band hold -infinity, so no direction leaves it.
+ *
+ *   C - computation instance whose score table is scored
+ *
+ *   col - column of the cell
+ *
+ *   row - row of the cell
+ */
+walk_table_cell_t
+derive_walk_cell(computation_t *C, int col, int row)
+{
+        score_table_t *S = C->score_table;
+        int d = C->indel_penalty;
+
+        if (col == 0 || row == 0) {
+                return col > 0 ? walk_left : (row > 0 ? walk_up : 0);
+        }
+
+        const int *prev = score_table_column(S, col - 1);
+        const int *this = score_table_column(S, col);
+        char top = C->top_string[col-1];
+        char side = C->side_string[row-1];
+        int diag_score = prev[row-1];
+        if (NULL != C->matrix) {
+                diag_score = diag_score +
+                        substitution_score(C->matrix, top, side);
+        } else if (top == side) {
+                diag_score = diag_score + C->match_score;
+        } else {
+                diag_score = diag_score - C->mismatch_penalty;
+        }
+
+        int score = this[row];
+        return (score == diag_score ? walk_diag : 0) |
+                (score == this[row-1] - d ? walk_up : 0) |
+                (score == prev[row] - d ? walk_left : 0);
+}
+
+/*
+ * score_cell_column()
+ *
+ *   Write alignment scores to a run of cells in one column of a
+ *   computation's score table.  The cells above the run and the cells
+ *   in the column to its left must already be scored.
+ *
+ *     C - pointer to the computation instance containing the target
+ *         score table
+ *
+ *   col - index of the column of cells to score
+ *
+ *   first_row - first row of the run
+ *
+ *   last_row - last row of the run
+ */
+void
+score_cell_column(computation_t *C, int col, int first_row, int last_row)
+{
+        score_column_with(C, col, first_row, last_row, C->match_score,
+                          C->mismatch_penalty, C->indel_penalty, 0);
+}
+
+/*
+ * score_cell_column_profile()
+ *
+ *   The column kernel for scoring with a substitution matrix, which
+ *   takes each diagonal bonus from the computation's query profile.
+ *   See score_cell_column().
+ */
+void
+score_cell_column_profile(computation_t *C,
+                          int col,
+                          int first_row,
+                          int last_row)
+{
+        score_column_with(C, col, first_row, last_row, 0, 0,
+                          C->indel_penalty, 1);
+}
+
+/*
+ * score_cell_column_affine()
+ *
+ *   The column kernel for affine gaps.  See score_column_affine_with()
+ *   and score_cell_column().
+ */
+void
+score_cell_column_affine(computation_t *C,
+                         int col,
+                         int first_row,
+                         int last_row)
+{
+        score_column_affine_with(C, col, first_row, last_row,
+                                 C->match_score, C->mismatch_penalty,
+                                 C->indel_penalty, C->gap_extend_penalty,
+                                 0);
+}
+
+/*
+ * score_cell_column_affine_profile()
+ *
+ *   The column kernel for affine gaps and a substitution matrix.  See
+ *   score_cell_column_affine() and score_cell_column_profile().
+ */
+void
+score_cell_column_affine_profile(computation_t *C,
+                                 int col,
+                                 int first_row,
+                                 int last_row)
+{
+        score_column_affine_with(C, col, first_row, last_row, 0, 0,
+                                 C->indel_penalty, C->gap_extend_penalty,
+                                 1);
+}
+
+/* Where the two-column engines take the diagonal bonuses of a column
+   from */
+typedef enum {
+        bonus_from_chars,       /* comparing characters */
+        bonus_from_packed,      /* the match bits of a packed side */
+        bonus_from_profile      /* a query profile row */
+} bonus_source_t;
+
+/*
+ * diag_bonus_with()
+ *
+ *   Return the diagonal bonus of row row of a column of the two-column
+ *   engines, whose top character is t, from source: comparing t with
+ *   side, bit row - first of match_bits, or bonus[row].
+ */
+static inline __attribute__((always_inline)) int
+diag_bonus_with(bonus_source_t source,
+                const int *bonus,
+                uint32_t match_bits,
+                char t,
+                const char *side,
+                int first,
+                int row,
+                int m,
+                int k)
+{
+        if (source == bonus_from_profile) {
+                return bonus[row];
+        } else if (source == bonus_from_packed) {
+                int match = (match_bits >> (row - first)) & 1;
+                return match * (m + k) - k;
+        }
+        return t == side[row-1] ? m : -k;
+}
+
+/*
+ * score_rows_with()
+ *
+ *   Score rows first through last of the current column for
+ *   score_two_columns(), taking the diagonal bonuses from source (see
+ *   diag_bonus_with()).  Each call with a constant source compiles to
+ *   a loop of its own.
+ */
+static inline __attribute__((always_inline)) void
+score_rows_with(bonus_source_t source,
+                const int *prev,
+                int *this,
+                int first,
+                int last,
+                const int *bonus,
+                uint32_t match_bits,
+                char t,
+                const char *side,
+                int m,
+                int k,
+                int d)
+{
+        for (int row = first; row <= last; row++) {
+                int score = prev[row-1] + diag_bonus_with(
+                        source, bonus, match_bits, t, side, first, row, m, k);
+                int up_score = this[row-1] - d;
+                int left_score = prev[row] - d;
+                if (score < up_score)
+                        score = up_score;
+                if (score < left_score)
+                        score = left_score;
+                this[row] = score;
+        }
+}
+
+/*
+ * init_column_sweep()
+ *
+ *   Make side ready for scoring columns against it with match bonus m,
+ *   mismatch penalty k, and indel penalty d, or with the substitution
+ *   matrix in place of m and k if it isn't NULL.
+ *
+ *   Each column sweeps side, so we pack it if it is DNA (see
+ *   packed-sequence.h) and test 32 bases per word; the bonuses then
+ *   need no branch.
+ */
+void
+init_column_sweep(column_sweep_t *W,
+                  const char *side,
+                  int m,
+                  int k,
+                  int d,
+                  const substitution_matrix_t *matrix)
+{
+        W->side = side;
+        W->side_len = strlen(side);
+        W->m = m;
+        W->k = k;
+        W->d = d;
+        W->matrix = matrix;
+        W->profile = NULL != matrix ? alloc_query_profile(matrix, side)
+                                    : NULL;
+        W->packed = NULL == matrix ? pack_sequence(side) : NULL;
+}
+
+void
+free_column_sweep(column_sweep_t *W)
+{
+        free(W->profile);
+        if (NULL != W->packed) {
+                free_packed_sequence(W->packed);
+        }
+}
+
+/*
+ * score_sweep_column()
+ *
+ *   Score column col of the table of some top string against the side
+ *   characters [first, first + rows) of a column sweep, from the column
+ *   before it.  t is the column's top character.  prev and this hold
+ *   rows + 1 scores each, row 0 being the top row of the table.
+ */
+void
+score_sweep_column(const column_sweep_t *W,
+                   char t,
+                   int col,
+                   int first,
+                   int rows,
+                   const int *prev,
+                   int *this)
+{
+        int m = W->m;
+        int k = W->k;
+        int d = W->d;
+
+        this[0] = -col * d;
+        if (NULL != W->profile) {
+                const int *bonus = query_profile_row(W->matrix, W->profile,
+                                                     W->side_len, t);
+                score_rows_with(bonus_from_profile, prev, this, 1, rows,
+                                bonus + first, 0, t, W->side + first,
+                                m, k, d);
+        } else if (NULL == W->packed) {
+                score_rows_with(bonus_from_chars, prev, this, 1, rows,
+                                NULL, 0, t, W->side + first, m, k, d);
+        } else {
+                for (int row = 1; row <= rows;
+                     row += PACKED_BASES_PER_WORD) {
+                        int last = row + PACKED_BASES_PER_WORD - 1;
+                        if (last > rows)
+                                last = rows;
+                        score_rows_with(bonus_from_packed, prev, this,
+                                        row, last, NULL,
+                                        packed_match_bits(W->packed, t,
+                                                          first + row - 1),
+                                        t, W->side + first, m, k, d);
+                }
+        }
+}
+
+/*
+ * column_sweep_bonus()
+ *
+ *   Return the diagonal bonus for aligning top character t with side
+ *   character i of a column sweep.
+ */
+int
+column_sweep_bonus(const column_sweep_t *W, char t, int i)
+{
+        if (NULL != W->profile) {
+                return query_profile_row(W->matrix, W->profile, W->side_len,
+                                         t)[i + 1];
+        }
+        return t == W->side[i] ? W->m : -W->k;
+}
+
+/*
+ * score_two_columns()
+ *
+ *   Return the optimal alignment score of top and side, scoring with
+ *   match bonus m, mismatch penalty k, and indel penalty d, or with
+ *   the substitution matrix in place of m and k if it isn't NULL.
+ *   Only the previous and the current column of the score table are
+ *   kept, and no walk table is built, so memory is linear in the
+ *   length of side.
+ */
+int
+score_two_columns(const char *top,
+                  const char *side,
+                  int m,
+                  int k,
+                  int d,
+                  const substitution_matrix_t *matrix)
+{
+        int M = strlen(top) + 1;
+        int N = strlen(side) + 1;
+        int *prev = (int *)malloc(N * sizeof(int));
+        int *this = (int *)malloc(N * sizeof(int));
+        check(NULL != prev && NULL != this, "malloc failed");
+        column_sweep_t W;
+        init_column_sweep(&W, side, m, k, d, matrix);
+
+        for (int row = 0; row < N; row++) {
+                prev[row] = -row * d;
+        }
+
+        for (int col = 1; col < M; col++) {
+                score_sweep_column(&W, top[col-1], col, 0, N - 1, prev, this);
+                int *swap = prev;
+                prev = this;
+                this = swap;
+        }
+
+        int score = prev[N-1];
+        free(prev);
+        free(this);
+        free_column_sweep(&W);
+        return score;
+}
+
+/*
+ * score_affine_rows_with()
+ *
+ *   Like score_rows_with(), but for score_two_columns_affine(): left
+ *   gap scores are updated in place, and the up gap score carried down
+ *   the column is returned.
+ */
+static inline __attribute__((always_inline)) int
+score_affine_rows_with(bonus_source_t source,
+                       const int *prev,
+                       int *this,
+                       int *left_gap,
+                       int up_gap,
+                       int first,
+                       int last,
+                       const int *bonus,
+                       uint32_t match_bits,
+                       char t,
+                       const char *side,
+                       int m,
+                       int k,
+                       int d,
+                       int e)
+{
+        for (int row = first; row <= last; row++) {
+                int left_score = prev[row] - d;
+                if (left_score < left_gap[row] - e)
+                        left_score = left_gap[row] - e;
+                up_gap = up_gap - e;
+                if (up_gap < this[row-1] - d)
+                        up_gap = this[row-1] - d;
+
+                int score = prev[row-1] + diag_bonus_with(
+                        source, bonus, match_bits, t, side, first, row, m, k);
+                if (score < up_gap)
+                        score = up_gap;
+                if (score < left_score)
+                        score = left_score;
+                this[row] = score;
+                left_gap[row] = left_score;
+        }
+        return up_gap;
+}
+
+/*
+ * score_two_columns_affine()
+ *
+ *   Like score_two_columns(), but with affine gaps: gaps cost d to
+ *   open and e to extend (see score_column_affine_with()).  Alongside
+ *   the two columns of scores we keep the left gap scores of one
+ *   column.
+ */
+int
+score_two_columns_affine(const char *top,
+                         const char *side,
+                         int m,
+                         int k,
+                         int d,
+                         int e,
+                         const substitution_matrix_t *matrix)
+{
+        int M = strlen(top) + 1;
+        int N = strlen(side) + 1;
+        int *prev = (int *)malloc(N * sizeof(int));
+        int *this = (int *)malloc(N * sizeof(int));
+        int *left_gap = (int *)malloc(N * sizeof(int));
+        check(NULL != prev && NULL != this && NULL != left_gap,
+              "malloc failed");
+        int *profile = NULL != matrix ? alloc_query_profile(matrix, side)
+                                      : NULL;
+        packed_sequence_t *packed = NULL == matrix ? pack_sequence(side)
+                                                   : NULL;
+
+        prev[0] = 0;
+        for (int row = 1; row < N; row++) {
+                prev[row] = -d - (row - 1) * e;
+                left_gap[row] = SCORE_NEG_INF;
+        }
+
+        for (int col = 1; col < M; col++) {
+                char t = top[col-1];
+                int up_gap = SCORE_NEG_INF;
+                this[0] = -d - (col - 1) * e;
+                if (NULL != profile) {
+                        score_affine_rows_with(bonus_from_profile, prev,
+                                               this, left_gap, up_gap,
+                                               1, N - 1,
+                                               query_profile_row(
+                                                       matrix, profile,
+                                                       N - 1, t),
+                                               0, t, side, m, k, d, e);
+                } else if (NULL == packed) {
+                        score_affine_rows_with(bonus_from_chars, prev,
+                                               this, left_gap, up_gap,
+                                               1, N - 1, NULL, 0, t, side,
+                                               m, k, d, e);
+                } else {
+                        for (int first = 1; first < N;
+                             first += PACKED_BASES_PER_WORD) {
+                                int last = first + PACKED_BASES_PER_WORD - 1;
+                                if (last > N - 1)
+                                        last = N - 1;
+                                up_gap = score_affine_rows_with(
+                                        bonus_from_packed, prev, this,
+                                        left_gap, up_gap, first, last, NULL,
+                                        packed_match_bits(packed, t,
+                                                          first - 1),
+                                        t, side, m, k, d, e);
+                        }
+                }
+                int *swap = prev;
+                prev = this;
+                this = swap;
+        }
+
+        int score = prev[N-1];
+        free(prev);
+        free(this);
+        free(left_gap);
+        free(profile);
+        if (NULL != packed) {
+                free_packed_sequence(packed);
+        }
+        return score;
+}
+
+/* One column kernel per parameter set in score-params.h */
+#define PARAM_SET(id, m, k, d)                                          \
+        static void                                                     \
+        score_cell_column_##id(computation_t *C,                        \
+                               int col,                                 \
+                               int first_row,                           \
+                               int last_row)                            \
+        {                                                               \
+                score_column_with(C, col, first_row, last_row,          \
+                                  m, k, d, 0);                          \
+        }
+#include "score-params.h"
+#undef PARAM_SET
+
+const param_kernel_t param_kernels_generic[] = {
+#define PARAM_SET(id, m, k, d) { m, k, d, score_cell_column_##id },
+#include "score-params.h"
+#undef PARAM_SET
+        { 0, 0, 0, NULL }
+};
@@ -0,0 +1,376 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * score-kernel.h - Prototypes for the column kernels implemented in
+ *                  score-kernel.c and score-kernel-simd.c.  A column
+ *                  kernel writes scores (and walk table directions, if
+ *                  the computation keeps a walk table) to a run of
+ *                  cells in one column of a computation's score table.
+ */
+
+#ifndef __SCORE_KERNEL_H__
+#define __SCORE_KERNEL_H__
+
+#include <stdint.h>
+
+#include "computation.h"
+#include "packed-sequence.h"
+#include "score-table.h"
+#include "substitution-matrix.h"
+#include "walk-table.h"
+
+/* column_sweep_t: A side string made ready for scoring columns against
+ *                 it two at a time, as score_two_columns() and the
+ *                 sweeps of hirschberg.c do: the scoring rules, and the
+ *                 side's query profile if they use a substitution
+ *                 matrix, or else its packed form if it is DNA. */
+typedef struct column_sweep {
+        const char *side;
+        int side_len;
+        int m;
+        int k;
+        int d;
+        const substitution_matrix_t *matrix;
+        int *profile;                   /* NULL without a matrix */
+        packed_sequence_t *packed;      /* NULL unless DNA, without one */
+} column_sweep_t;
+
+/* A column kernel (see computation_t) */
+typedef void (*score_column_fn)(computation_t *C,
+                                int col,
+                                int first_row,
+                                int last_row);
+
+/* param_kernel_t: A column kernel built for one set of scoring
+ *                 parameters (see PARAMS in the Makefile).  Tables of
+ *                 these end with an entry whose score_column is NULL. */
+typedef struct param_kernel {
+        int match_score;
+        int mismatch_penalty;
+        int indel_penalty;
+        score_column_fn score_column;
+} param_kernel_t;
+
+/*
+ * score_column_with()
+ *
+ *   Write alignment scores to the cells first_row through last_row of
+ *   column col, one cell at a time, scoring with match bonus m,
+ *   mismatch penalty k, and indel penalty d.  If profiled is nonzero,
+ *   m and k are ignored, and the diagonal bonuses come from the
+ *   computation's query profile instead.  Otherwise we read the packed
+ *   side string, if there is one.  Every scalar column kernel
+ *   is an instance of this; called with constant parameters, it
+ *   compiles to a kernel with the parameters folded in.
+ */
+static inline __attribute__((always_inline)) void
+score_column_with(computation_t *C,
+                  int col,
+                  int first_row,
+                  int last_row,
+                  int m,
+                  int k,
+                  int d,
+                  int profiled)
+{
+        score_table_t *S = C->score_table;
+        const int *prev = score_table_column(S, col - 1);
+        int *this = score_table_column(S, col);
+        char top = C->top_string[col-1];
+        const int *bonus = profiled ?
+                query_profile_row(C->matrix, C->query_profile, S->N - 1,
+                                  top) : NULL;
+        const packed_sequence_t *packed = profiled ? NULL : C->packed_side;
+        uint32_t match_bits = 0;
+
+        for (int row = first_row; row <= last_row; row++) {
+                /* Candidate scores, computed from the cells above, to
+                   the left, and diagonally up-left of the target cell */
+                int up_score = this[row-1] - d;
+                int left_score = prev[row] - d;
+                int diag_score = prev[row-1];
+                if (profiled) {
+                        diag_score = diag_score + bonus[row];
+                } else if (NULL != packed) {
+                        /* Test the bases of 32 rows at a time */
+                        if ((row - first_row) % PACKED_BASES_PER_WORD == 0) {
+                                match_bits = packed_match_bits(packed, top,
+                                                               row - 1);
+                        }
+                        diag_score = diag_score + (match_bits & 1 ? m : -k);
+                        match_bits = match_bits >> 1;
+                } else if (top == C->side_string[row-1]) {
+                        diag_score = diag_score + m;
+                } else {
+                        diag_score = diag_score - k;
+                }
+
+                /* The current cell's score is the max of the three
+                   candidate scores */
+                int score = diag_score;
+                if (score < up_score)
+                        score = up_score;
+                if (score < left_score)
+                        score = left_score;
+                this[row] = score;
+
+                /* Mark the optimal paths in the walk table.  Provided
+                   that a path's score is equal to the target cell's
+                   score, i.e. the maximum of the three candidate
+                   scores, it is an optimal path. */
+                mark_walk_cell(C->walk_table, col, row,
+                               score == diag_score,
+                               score == up_score,
+                               score == left_score);
+        }
+}
+
+/*
+ * score_column_affine_with()
+ *
+ *   Like score_column_with(), but with affine gaps: a run of indels
+ *   costs d for the first and e for each one after it.  Following
+ *   Gotoh, each cell has three scores: H, the best of any alignment
+ *   ending at the cell, which is what the score table holds; E, the
+ *   best ending in a left gap; and F, the best ending in an up gap.
+ *   All three are computed in one pass down the column.  E comes from
+ *   the same row of the column to the left, so one E per row is kept
+ *   in C->left_gap_scores and updated in place; F comes from the cell
+ *   above, so it is carried down the run and left in C->up_gap_scores
+ *   for the run below.  profiled is as for score_column_with().
+ */
+static inline __attribute__((always_inline)) void
+score_column_affine_with(computation_t *C,
+                         int col,
+                         int first_row,
+                         int last_row,
+                         int m,
+                         int k,
+                         int d,
+                         int e,
+                         int profiled)
+{
+        score_table_t *S = C->score_table;
+        const int *prev = score_table_column(S, col - 1);
+        int *this = score_table_column(S, col);
+        int *left_gap = C->left_gap_scores;
+        char top = C->top_string[col-1];
+        const int *bonus = profiled ?
+                query_profile_row(C->matrix, C->query_profile, S->N - 1,
+                                  top) : NULL;
+        const packed_sequence_t *packed = profiled ? NULL : C->packed_side;
+        uint32_t match_bits = 0;
+        int up_gap = C->up_gap_scores[col];
+
+        for (int row = first_row; row <= last_row; row++) {
+                /* A left gap opens after the cell to the left or
+                   extends the left gap ending there; likewise for an
+                   up gap and the cell above */
+                int left_open = prev[row] - d;
+                int left_extend = left_gap[row] - e;
+                int left_score = left_open > left_extend ?
+                        left_open : left_extend;
+                int up_open = this[row-1] - d;
+                int up_extend = up_gap - e;
+                int up_score = up_open > up_extend ? up_open : up_extend;
+
+                int diag_score = prev[row-1];
+                if (profiled) {
+                        diag_score = diag_score + bonus[row];
+                } else if (NULL != packed) {
+                        /* Test the bases of 32 rows at a time */
+                        if ((row - first_row) % PACKED_BASES_PER_WORD == 0) {
+                                match_bits = packed_match_bits(packed, top,
+                                                               row - 1);
+                        }
+                        diag_score = diag_score + (match_bits & 1 ? m : -k);
+                        match_bits = match_bits >> 1;
+                } else if (top == C->side_string[row-1]) {
+                        diag_score = diag_score + m;
+                } else {
+                        diag_score = diag_score - k;
+                }
+
+                int score = diag_score;
+                if (score < up_score)
+                        score = up_score;
+                if (score < left_score)
+                        score = left_score;
+                this[row] = score;
+                left_gap[row] = left_score;
+                up_gap = up_score;
+
+                mark_affine_walk_cell(C->walk_table, col, row,
+                                      score == diag_score,
+                                      score == up_score,
+                                      score == left_score,
+                                      (left_score == left_open ?
+                                       left_gap_open : 0) |
+                                      (left_score == left_extend ?
+                                       left_gap_extend : 0) |
+                                      (up_score == up_open ?
+                                       up_gap_open : 0) |
+                                      (up_score == up_extend ?
+                                       up_gap_extend : 0));
+        }
+
+        C->up_gap_scores[col] = up_gap;
+}
+
+/*
+ * Prototypes
+ */
+
+void score_cell(computation_t *C, int col, int row);
+
+walk_table_cell_t derive_walk_cell(computation_t *C, int col, int row);
+
+void score_cell_column(computation_t *C, int col, int first_row, int last_row);
+
+void score_cell_column_profile(computation_t *C,
+                               int col,
+                               int first_row,
+                               int last_row);
+
+void init_column_sweep(column_sweep_t *W,
+                       const char *side,
+                       int m,
+                       int k,
+                       int d,
+                       const substitution_matrix_t *matrix);
+
+void free_column_sweep(column_sweep_t *W);
+
+void score_sweep_column(const column_sweep_t *W,
+                        char t,
+                        int col,
+                        int first,
+                        int rows,
+                        const int *prev,
+                        int *this);
+
+int column_sweep_bonus(const column_sweep_t *W, char t, int i);
+
+int score_two_columns(const char *top,
+                      const char *side,
+                      int m,
+                      int k,
+                      int d,
+                      const substitution_matrix_t *matrix);
+
+void score_cell_column_affine(computation_t *C,
+                              int col,
+                              int first_row,
+                              int last_row);
+
+void score_cell_column_affine_profile(computation_t *C,
+                                      int col,
+                                      int first_row,
+                                      int last_row);
+
+int score_two_columns_affine(const char *top,
+                             const char *side,
+                             int m,
+                             int k,
+                             int d,
+                             int e,
+                             const substitution_matrix_t *matrix);
+
+/* SIMD variants, built from score-kernel-simd.c */
+void score_cell_column_sse41(computation_t *C,
+                             int col,
+                             int first_row,
+                             int last_row);
+
+void score_cell_column_avx2(computation_t *C,
+                            int col,
+                            int first_row,
+                            int last_row);
+
+void score_cell_column_avx512(computation_t *C,
+                              int col,
+                              int first_row,
+                              int last_row);
+
+void score_cell_column_profile_sse41(computation_t *C,
+                                     int col,
+                                     int first_row,
+                                     int last_row);
+
+void score_cell_column_profile_avx2(computation_t *C,
+                                    int col,
+                                    int first_row,
+                                    int last_row);
+
+void score_cell_column_profile_avx512(computation_t *C,
+                                      int col,
+                                      int first_row,
+                                      int last_row);
+
+void score_cell_column_affine_sse41(computation_t *C,
+                                    int col,
+                                    int first_row,
+                                    int last_row);
+
+void score_cell_column_affine_avx2(computation_t *C,
+                                   int col,
+                                   int first_row,
+                                   int last_row);
+
+void score_cell_column_affine_avx512(computation_t *C,
+                                     int col,
+                                     int first_row,
+                                     int last_row);
+
+void score_cell_column_affine_profile_sse41(computation_t *C,
+                                            int col,
+                                            int first_row,
+                                            int last_row);
+
+void score_cell_column_affine_profile_avx2(computation_t *C,
+                                           int col,
+                                           int first_row,
+                                           int last_row);
+
+void score_cell_column_affine_profile_avx512(computation_t *C,
+                                             int col,
+                                             int first_row,
+                                             int last_row);
+
+/* Kernels built for the parameter sets in PARAMS, per instruction set */
+extern const param_kernel_t param_kernels_generic[];
+extern const param_kernel_t param_kernels_sse41[];
+extern const param_kernel_t param_kernels_avx2[];
+extern const param_kernel_t param_kernels_avx512[];
+
+#endif /* __SCORE_KERNEL_H__ */
@@ -54,11 +54,14 @@
  *
  *   N - number of rows in the table
  *
+ *   band - half-width of the band of cells to store (see score-table.h),
+ *          or -1 to store every cell
+ *
  *   return - allocated score_table_t pointer with an allocated MxN
- *            score_table_cell_t matrix
+ *            matrix of scores, or a band of one
  */
 score_table_t *
-alloc_score_table(int M, int N)
+alloc_score_table(int M, int N, int band)
 {
         /* Allocate for the scores table */
         score_table_t *S = (score_table_t *)malloc(sizeof(score_table_t));
@@ -66,45 +69,39 @@ alloc_score_table(int M, int N)
 
         S->M = M;
         S->N = N;
+        S->band = band;
 
-        /* Allocate top-level array for S->cells */
-        S->cells = (score_table_cell_t **)malloc(M * sizeof(score_table_cell_t *));
-        check(NULL != S->cells, "malloc failed");
+        if (band < 0) {
+                /* Allocate every score in one column-major block.  A
+                   column is N contiguous scores, so walking down a
+                   column walks through memory. */
+                S->column_step = N;
+                S->column_skew = 0;
+                S->scores = (int *)calloc((size_t)M * N, sizeof(int));
+                check(NULL != S->scores, "calloc failed");
+                return S;
+        }
 
-        /* Allocate subarrays for S->cells */
-        for (int i = 0; i < M; i++) {
-                S->cells[i] = (score_table_cell_t *)calloc(N, sizeof(score_table_cell_t));
-                check(NULL != S->cells[i], "malloc failed");
+        /* Column col holds rows col - band - 1 through col + band + 1.
+           Every score starts out as -infinity, so the cells bordering
+           the band are never on an optimal path. */
+        size_t size = (size_t)M * (2 * (size_t)band + 3);
+        S->column_step = 2 * (size_t)band + 2;
+        S->column_skew = (size_t)band + 1;
+        S->scores = (int *)malloc(size * sizeof(int));
+        check(NULL != S->scores, "malloc failed");
+        for (size_t i = 0; i < size; i++) {
+                S->scores[i] = SCORE_NEG_INF;
         }
 
         return S;
 }
 
 void
-free_score_table(score_table_t *S, unsigned int nthreads)
+free_score_table(score_table_t *S)
 {
-        /* Destroy mutex and conditional variable objects */
-        int res;
-        if (nthreads > 1) {
-                for (int i = 0; i < S->M; i++) {
-                        for (int j = 0; j < S->N; j++) {
-                                res = pthread_mutex_destroy(
-                                        &S->cells[i][j].score_mutex);
-                                check(0 == res, "pthread_mutex_destroy failed");
-                                res = pthread_cond_destroy(
-                                        &S->cells[i][j].processed_cv);
-                                check(0 == res, "pthread_cond_destroy failed");
-                        }
-                }
-        }
-
-        /* Free each subarray (column) of cells */
-        for (int i = 0; i < S->M; i++) {
-                free(S->cells[i]);
-        }
-
-        /* Free the top-level array of cell pointers */
-        free(S->cells);
+        /* Free the block of scores */
+        free(S->scores);
 
         /* Free the scores table itself */
         free(S);
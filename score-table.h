@@ -40,43 +40,95 @@
 #ifndef __TABLE_H__
 #define __TABLE_H__
 
-#include <pthread.h>
+#include <limits.h>
+#include <stddef.h>
 
 #include "walk-table.h"
 
+/* Score of the cells just outside a band, low enough that no optimal
+   path leaves the band yet far enough from INT_MIN that subtracting
+   penalties from it cannot overflow */
+#define SCORE_NEG_INF (INT_MIN / 2)
+
 /* arrow_t: A type describing directions in the scores table. */
 /* typedef enum {left, up, diag} arrow_t; */
 
-/* cell_t: A type describing a cell in the scores table. */
-typedef struct score_table_cell {
-        int score;
-        /* int diag; */
-        /* int left; */
-        /* int up; */
-        /* int diag_done; */
-        /* int left_done; */
-        /* int up_done; */
-        /* arrow_t src_direction; */
-        int match;
-        /* int in_optimal_path; */
-        int processed;
-        pthread_mutex_t score_mutex;
-        pthread_cond_t processed_cv;
-} score_table_cell_t;
-
-/* table_t: A type describing an MxN table of cells (i.e. matrix of
- *          cell_t). */
+/* table_t: A type describing an MxN table of scores.  The scores live
+ *          in a single column-major array; use score_table_get(),
+ *          score_table_set(), and score_table_column() to address
+ *          them.
+ *
+ *          A banded table stores only the cells (col, row) with
+ *          |col - row| <= band, plus one cell above and one below each
+ *          column's run holding SCORE_NEG_INF.  Each column then takes
+ *          2*band + 3 scores, and is shifted down one row from the
+ *          column to its left. */
 typedef struct score_table {
         int M;
         int N;
-        score_table_cell_t **cells;
-        int greatest_abs_val;
-        /* unsigned int branch_count; */
-        /* pthread_rwlock_t branch_count_rwlock; */
+        int band;               /* -1 if every cell is stored */
+        size_t column_step;     /* scores between adjacent columns */
+        size_t column_skew;     /* offset of row 0 from column start */
+        int *scores;
 } score_table_t;
 
-/* Allocate an MxN table of score_table_cells */
-score_table_t *alloc_score_table(int M, int N);
+/* Return a pointer to the score at row 0 of column col.  Only the rows
+   of the column the table stores may be read through it. */
+static inline int *
+score_table_column(score_table_t *S, int col)
+{
+        return &S->scores[(size_t)col * S->column_step + S->column_skew];
+}
+
+/* Return the first row of column col the table stores a score for */
+static inline int
+score_table_first_row(score_table_t *S, int col)
+{
+        return (S->band < 0 || col <= S->band) ? 0 : col - S->band;
+}
+
+/* Return the last row of column col the table stores a score for */
+static inline int
+score_table_last_row(score_table_t *S, int col)
+{
+        return (S->band < 0 || col + S->band >= S->N - 1) ?
+                S->N - 1 : col + S->band;
+}
+
+/* Return 1 if the table stores a score for (col, row), 0 if not */
+static inline int
+score_table_has_cell(score_table_t *S, int col, int row)
+{
+        return score_table_first_row(S, col) <= row &&
+                row <= score_table_last_row(S, col);
+}
+
+/* Return 1 if (col, row) borders a cell outside the table's band, 0 if
+   not, or if the table has no band */
+static inline int
+score_table_on_band_edge(score_table_t *S, int col, int row)
+{
+        return S->band >= 0 &&
+                ((col - row == S->band && col + 1 < S->M) ||
+                 (row - col == S->band && row + 1 < S->N));
+}
+
+/* Return the score at (col, row) */
+static inline int
+score_table_get(score_table_t *S, int col, int row)
+{
+        return score_table_column(S, col)[row];
+}
+
+/* Set the score at (col, row) */
+static inline void
+score_table_set(score_table_t *S, int col, int row, int score)
+{
+        score_table_column(S, col)[row] = score;
+}
+
+/* Allocate an MxN table of scores, banded if band is not -1 */
+score_table_t *alloc_score_table(int M, int N, int band);
 
 /* Print the score table */
 void print_table(score_table_t *S,
@@ -85,7 +137,7 @@ void print_table(score_table_t *S,
                  char *s2,
                  int unicode);
 
-/* Destroy a table of M score_table_cell_t pointers */
-void free_score_table(score_table_t *S, unsigned int nthreads);
+/* Destroy a score table and its block of scores */
+void free_score_table(score_table_t *S);
 
 #endif /* __TABLE_H__ */
@@ -0,0 +1,285 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * simd.h - A thin layer of macros over the x86 vector extensions used
+ *          by the scoring kernels.  A vector holds SIMD_LANES 32-bit
+ *          scores; lane 0 is the lowest row of the table.  Compares
+ *          yield a mask that v_blendv(), v_movemask() and v_any()
+ *          accept.
+ *
+ *          The v8_ and v16_ operations treat a vector as 4 or 2 times
+ *          as many 8- or 16-bit lanes, and their additions saturate.
+ *          The v32_ operations are the plain 32-bit ones under the
+ *          same names, so code can be written once for every width.
+ *
+ *          The kernel sources are compiled once per extension, and
+ *          SIMD_FN() gives each build's functions a distinct suffix.
+ *          When the compiler targets none of AVX-512 (F and BW), AVX2
+ *          or SSE4.1, SIMD_LANES is left undefined and nothing is
+ *          built.
+ */
+
+#ifndef __SIMD_H__
+#define __SIMD_H__
+
+#include <limits.h>
+
+/* A score below every real score that survives a handful of
+ * subtractions without wrapping around */
+#define SIMD_NEG_INF (INT_MIN / 2)
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+
+#include <immintrin.h>
+
+#define SIMD_LANES 16
+#define SIMD_FN(name) name ## _avx512
+
+typedef __m512i vint_t;
+
+#define v_load(p)       _mm512_load_si512((const void *)(p))
+#define v_store(p, x)   _mm512_store_si512((void *)(p), (x))
+#define v_loadu(p)      _mm512_loadu_si512((const void *)(p))
+#define v_storeu(p, x)  _mm512_storeu_si512((void *)(p), (x))
+#define v_set1(x)       _mm512_set1_epi32(x)
+#define v_add(a, b)     _mm512_add_epi32((a), (b))
+#define v_sub(a, b)     _mm512_sub_epi32((a), (b))
+#define v_max(a, b)     _mm512_max_epi32((a), (b))
+#define v_cmpeq(a, b)   _mm512_cmpeq_epi32_mask((a), (b))
+#define v_cmpgt(a, b)   _mm512_cmpgt_epi32_mask((a), (b))
+#define v_blendv(a, b, mask) _mm512_mask_blend_epi32((mask), (a), (b))
+#define v_movemask(mask) ((int)(mask))
+#define v_last(x)       _mm_extract_epi32( \
+        _mm512_extracti32x4_epi32((x), 3), 3)
+
+#define v_any(mask)     ((mask) != 0)
+
+#define v8_set1(x)      _mm512_set1_epi8(x)
+#define v8_add(a, b)    _mm512_adds_epi8((a), (b))
+#define v8_sub(a, b)    _mm512_subs_epi8((a), (b))
+#define v8_max(a, b)    _mm512_max_epi8((a), (b))
+#define v8_min(a, b)    _mm512_min_epi8((a), (b))
+#define v8_cmpgt(a, b)  _mm512_cmpgt_epi8_mask((a), (b))
+#define v8_shift1(x, fill) _mm512_alignr_epi8((x), \
+        _mm512_alignr_epi64((x), (fill), 6), 15)
+
+#define v16_set1(x)     _mm512_set1_epi16(x)
+#define v16_add(a, b)   _mm512_adds_epi16((a), (b))
+#define v16_sub(a, b)   _mm512_subs_epi16((a), (b))
+#define v16_max(a, b)   _mm512_max_epi16((a), (b))
+#define v16_min(a, b)   _mm512_min_epi16((a), (b))
+#define v16_cmpgt(a, b) _mm512_cmpgt_epi16_mask((a), (b))
+#define v16_shift1(x, fill) _mm512_alignr_epi8((x), \
+        _mm512_alignr_epi64((x), (fill), 6), 14)
+
+#define v_min(a, b)     _mm512_min_epi32((a), (b))
+
+/* Lanes i*d for i = 1 .. SIMD_LANES */
+#define v_steps(d)      _mm512_setr_epi32((d), 2*(d), 3*(d), 4*(d), \
+                                          5*(d), 6*(d), 7*(d), 8*(d), \
+                                          9*(d), 10*(d), 11*(d), 12*(d), \
+                                          13*(d), 14*(d), 15*(d), 16*(d))
+
+/* Move each lane of x up by n lanes, filling the vacated low lanes from
+ * the matching lanes of fill */
+#define v_shift1(x, fill) _mm512_mask_blend_epi32(0x0001, \
+        _mm512_permutexvar_epi32(_mm512_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6, \
+                7, 8, 9, 10, 11, 12, 13, 14), (x)), (fill))
+#define v_shift2(x, fill) _mm512_mask_blend_epi32(0x0003, \
+        _mm512_permutexvar_epi32(_mm512_setr_epi32(0, 0, 0, 1, 2, 3, 4, 5, \
+                6, 7, 8, 9, 10, 11, 12, 13), (x)), (fill))
+#define v_shift4(x, fill) _mm512_mask_blend_epi32(0x000F, \
+        _mm512_permutexvar_epi32(_mm512_setr_epi32(0, 0, 0, 0, 0, 1, 2, 3, \
+                4, 5, 6, 7, 8, 9, 10, 11), (x)), (fill))
+#define v_shift8(x, fill) _mm512_mask_blend_epi32(0x00FF, \
+        _mm512_permutexvar_epi32(_mm512_setr_epi32(0, 0, 0, 0, 0, 0, 0, 0, \
+                0, 1, 2, 3, 4, 5, 6, 7), (x)), (fill))
+
+/* Load SIMD_LANES characters, zero-extended to one per lane */
+static inline vint_t
+v_load_chars(const char *p)
+{
+        return _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)p));
+}
+
+/* Mask selecting the lanes whose bits are set in bits, lowest lane in
+ * bit 0 */
+#define v_bits_mask(bits) ((__mmask16)(bits))
+
+#elif defined(__AVX2__)
+
+#include <immintrin.h>
+
+#define SIMD_LANES 8
+#define SIMD_FN(name) name ## _avx2
+
+typedef __m256i vint_t;
+
+#define v_load(p)       _mm256_load_si256((const __m256i *)(p))
+#define v_store(p, x)   _mm256_store_si256((__m256i *)(p), (x))
+#define v_loadu(p)      _mm256_loadu_si256((const __m256i *)(p))
+#define v_storeu(p, x)  _mm256_storeu_si256((__m256i *)(p), (x))
+#define v_set1(x)       _mm256_set1_epi32(x)
+#define v_add(a, b)     _mm256_add_epi32((a), (b))
+#define v_sub(a, b)     _mm256_sub_epi32((a), (b))
+#define v_max(a, b)     _mm256_max_epi32((a), (b))
+#define v_cmpeq(a, b)   _mm256_cmpeq_epi32((a), (b))
+#define v_cmpgt(a, b)   _mm256_cmpgt_epi32((a), (b))
+#define v_blendv(a, b, mask) _mm256_blendv_epi8((a), (b), (mask))
+#define v_movemask(x)   _mm256_movemask_ps(_mm256_castsi256_ps(x))
+#define v_last(x)       _mm256_extract_epi32((x), 7)
+
+#define v_any(mask)     (!_mm256_testz_si256((mask), (mask)))
+
+/* The byte shifts move within each 128-bit half; the permute supplies
+ * the bytes that cross into the upper half */
+#define v8_set1(x)      _mm256_set1_epi8(x)
+#define v8_add(a, b)    _mm256_adds_epi8((a), (b))
+#define v8_sub(a, b)    _mm256_subs_epi8((a), (b))
+#define v8_max(a, b)    _mm256_max_epi8((a), (b))
+#define v8_min(a, b)    _mm256_min_epi8((a), (b))
+#define v8_cmpgt(a, b)  _mm256_cmpgt_epi8((a), (b))
+#define v8_shift1(x, fill) _mm256_alignr_epi8((x), \
+        _mm256_permute2x128_si256((x), (fill), 0x03), 15)
+
+#define v16_set1(x)     _mm256_set1_epi16(x)
+#define v16_add(a, b)   _mm256_adds_epi16((a), (b))
+#define v16_sub(a, b)   _mm256_subs_epi16((a), (b))
+#define v16_max(a, b)   _mm256_max_epi16((a), (b))
+#define v16_min(a, b)   _mm256_min_epi16((a), (b))
+#define v16_cmpgt(a, b) _mm256_cmpgt_epi16((a), (b))
+#define v16_shift1(x, fill) _mm256_alignr_epi8((x), \
+        _mm256_permute2x128_si256((x), (fill), 0x03), 14)
+
+#define v_min(a, b)     _mm256_min_epi32((a), (b))
+
+#define v_steps(d)      _mm256_setr_epi32((d), 2*(d), 3*(d), 4*(d), \
+                                          5*(d), 6*(d), 7*(d), 8*(d))
+
+#define v_shift1(x, fill) _mm256_blend_epi32(_mm256_permutevar8x32_epi32( \
+        (x), _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6)), (fill), 0x01)
+#define v_shift2(x, fill) _mm256_blend_epi32(_mm256_permutevar8x32_epi32( \
+        (x), _mm256_setr_epi32(0, 0, 0, 1, 2, 3, 4, 5)), (fill), 0x03)
+#define v_shift4(x, fill) _mm256_blend_epi32(_mm256_permutevar8x32_epi32( \
+        (x), _mm256_setr_epi32(0, 0, 0, 0, 0, 1, 2, 3)), (fill), 0x0F)
+
+static inline vint_t
+v_load_chars(const char *p)
+{
+        return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p));
+}
+
+static inline vint_t
+v_bits_mask(unsigned int bits)
+{
+        const vint_t lane_bits = _mm256_setr_epi32(1, 2, 4, 8,
+                                                   16, 32, 64, 128);
+        return v_cmpeq(_mm256_and_si256(v_set1(bits), lane_bits), lane_bits);
+}
+
+#elif defined(__SSE4_1__)
+
+#include <smmintrin.h>
+#include <string.h>
+
+#define SIMD_LANES 4
+#define SIMD_FN(name) name ## _sse41
+
+typedef __m128i vint_t;
+
+#define v_load(p)       _mm_load_si128((const __m128i *)(p))
+#define v_store(p, x)   _mm_store_si128((__m128i *)(p), (x))
+#define v_loadu(p)      _mm_loadu_si128((const __m128i *)(p))
+#define v_storeu(p, x)  _mm_storeu_si128((__m128i *)(p), (x))
+#define v_set1(x)       _mm_set1_epi32(x)
+#define v_add(a, b)     _mm_add_epi32((a), (b))
+#define v_sub(a, b)     _mm_sub_epi32((a), (b))
+#define v_max(a, b)     _mm_max_epi32((a), (b))
+#define v_cmpeq(a, b)   _mm_cmpeq_epi32((a), (b))
+#define v_cmpgt(a, b)   _mm_cmpgt_epi32((a), (b))
+#define v_blendv(a, b, mask) _mm_blendv_epi8((a), (b), (mask))
+#define v_movemask(x)   _mm_movemask_ps(_mm_castsi128_ps(x))
+#define v_last(x)       _mm_extract_epi32((x), 3)
+
+#define v_any(mask)     (!_mm_testz_si128((mask), (mask)))
+
+#define v8_set1(x)      _mm_set1_epi8(x)
+#define v8_add(a, b)    _mm_adds_epi8((a), (b))
+#define v8_sub(a, b)    _mm_subs_epi8((a), (b))
+#define v8_max(a, b)    _mm_max_epi8((a), (b))
+#define v8_min(a, b)    _mm_min_epi8((a), (b))
+#define v8_cmpgt(a, b)  _mm_cmpgt_epi8((a), (b))
+#define v8_shift1(x, fill) _mm_alignr_epi8((x), (fill), 15)
+
+#define v16_set1(x)     _mm_set1_epi16(x)
+#define v16_add(a, b)   _mm_adds_epi16((a), (b))
+#define v16_sub(a, b)   _mm_subs_epi16((a), (b))
+#define v16_max(a, b)   _mm_max_epi16((a), (b))
+#define v16_min(a, b)   _mm_min_epi16((a), (b))
+#define v16_cmpgt(a, b) _mm_cmpgt_epi16((a), (b))
+#define v16_shift1(x, fill) _mm_alignr_epi8((x), (fill), 14)
+
+#define v_min(a, b)     _mm_min_epi32((a), (b))
+
+#define v_steps(d)      _mm_setr_epi32((d), 2*(d), 3*(d), 4*(d))
+
+#define v_shift1(x, fill) _mm_alignr_epi8((x), (fill), 12)
+#define v_shift2(x, fill) _mm_alignr_epi8((x), (fill), 8)
+
+static inline vint_t
+v_load_chars(const char *p)
+{
+        int c;
+        memcpy(&c, p, sizeof(c));
+        return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(c));
+}
+
+static inline vint_t
+v_bits_mask(unsigned int bits)
+{
+        const vint_t lane_bits = _mm_setr_epi32(1, 2, 4, 8);
+        return v_cmpeq(_mm_and_si128(v_set1(bits), lane_bits), lane_bits);
+}
+
+#endif
+
+#ifdef SIMD_LANES
+#define v32_set1        v_set1
+#define v32_add         v_add
+#define v32_sub         v_sub
+#define v32_max         v_max
+#define v32_min         v_min
+#define v32_cmpgt       v_cmpgt
+#define v32_shift1      v_shift1
+#endif
+
+#endif /* __SIMD_H__ */
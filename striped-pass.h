@@ -0,0 +1,223 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * striped-pass.h - One pass of the striped engine at one score width.
+ *                  striped.c includes this file once per width, with
+ *                  STRIPED_BITS defined as 8, 16, or 32; each include
+ *                  defines striped_pass_<bits>().  There is deliberately
+ *                  no include guard.
+ */
+
+#define SP_CAT(a, b)    a ## b
+#define SP_XCAT(a, b)   SP_CAT(a, b)
+
+/* Vector operation op at this pass's width, e.g. v8_max */
+#define VOP(op)         SP_XCAT(SP_XCAT(v, STRIPED_BITS), SP_CAT(_, op))
+
+#define ELEM            SP_XCAT(SP_XCAT(int, STRIPED_BITS), _t)
+#define ELEM_MIN        SP_XCAT(SP_XCAT(INT, STRIPED_BITS), _MIN)
+#define ELEM_MAX        SP_XCAT(SP_XCAT(INT, STRIPED_BITS), _MAX)
+#define LANES           (SIMD_LANES * 32 / STRIPED_BITS)
+#define IN_RANGE(x)     ((x) > ELEM_MIN && (x) < ELEM_MAX)
+
+/* Narrow lanes saturate, so their lowest value is a true -inf.  The
+ * 32-bit lanes wrap, and use SIMD_NEG_INF instead. */
+#if STRIPED_BITS < 32
+#define NEG_INF         ELEM_MIN
+#else
+#define NEG_INF         SIMD_NEG_INF
+#endif
+
+/*
+ * striped_pass_<bits>()
+ *
+ *   Compute the optimal alignment score of top and side in lanes of
+ *   STRIPED_BITS bits.
+ *
+ *   top, side - sequences to align, of lengths query_len and rows
+ *
+ *   profile_index - index of each side-string character's row in the
+ *                   query profile, and nchars, the number of rows
+ *
+ *   m, k, d - match bonus, mismatch penalty, and indel penalty
+ *
+ *   matrix - substitution matrix to score aligned characters with, or
+ *            NULL; with one, m is its highest score and -k its lowest
+ *
+ *   score - location to store the optimal score
+ *
+ *   return - 1 on success, or 0 if a score saturated the lanes and the
+ *            pass must be repeated at a wider width
+ */
+static int
+SP_XCAT(striped_pass_, STRIPED_BITS)(const char *top,
+                                     int query_len,
+                                     const char *side,
+                                     int rows,
+                                     const int *profile_index,
+                                     int nchars,
+                                     int m,
+                                     int k,
+                                     int d,
+                                     const substitution_matrix_t *matrix,
+                                     int *score)
+{
+        int seg_len = (query_len + LANES - 1) / LANES;
+
+#if STRIPED_BITS < 32
+        /* The bonuses, the penalty, and the seeded top row and left
+           column must fit the lanes unclipped; then any score clipped
+           while filling the rows ends up at either end of the range,
+           where the check below catches it. */
+        long long edge = (long long)(rows > seg_len * LANES ?
+                                     rows : seg_len * LANES) + 1;
+        if (!IN_RANGE(m) || !IN_RANGE(-(long long)k) || !IN_RANGE(d) ||
+            !IN_RANGE(edge * d) || !IN_RANGE(-edge * d)) {
+                return 0;
+        }
+#endif
+
+        /* Query profile: one striped row of diagonal bonuses for each
+           distinct character of the side string */
+        vint_t *profile = alloc_vectors((size_t)nchars * seg_len);
+        ELEM *lanes = (ELEM *)profile;
+        for (int c = 0; c < 256; c++) {
+                int p = profile_index[c];
+                if (p < 0) {
+                        continue;
+                }
+                for (int s = 0; s < seg_len; s++) {
+                        for (int l = 0; l < LANES; l++) {
+                                int j = l * seg_len + s;
+                                int bonus = -k;
+                                if (j < query_len && NULL != matrix) {
+                                        bonus = substitution_score(
+                                                matrix, top[j], c);
+                                } else if (j < query_len &&
+                                           (unsigned char)top[j] == c) {
+                                        bonus = m;
+                                }
+                                lanes[((size_t)p * seg_len + s) * LANES + l] =
+                                        bonus;
+                        }
+                }
+        }
+
+        /* Scores of the previous and current rows, seeded with the top
+           row of the table */
+        vint_t *h_load = alloc_vectors(seg_len);
+        vint_t *h_store = alloc_vectors(seg_len);
+        lanes = (ELEM *)h_load;
+        for (int s = 0; s < seg_len; s++) {
+                for (int l = 0; l < LANES; l++) {
+                        lanes[s * LANES + l] = -(l * seg_len + s + 1) * d;
+                }
+        }
+
+        const vint_t ninf = VOP(set1)(NEG_INF);
+        const vint_t vd = VOP(set1)(d);
+#if STRIPED_BITS < 32
+        vint_t lo = VOP(set1)(ELEM_MAX);
+        vint_t hi = VOP(set1)(ELEM_MIN);
+#endif
+
+        for (int i = 1; i <= rows; i++) {
+                const vint_t *p = profile +
+                        (size_t)profile_index[(unsigned char)side[i-1]] *
+                        seg_len;
+
+                /* The left column of the table scores -i*d in row i */
+                vint_t f = VOP(shift1)(ninf, VOP(set1)(-(i + 1) * d));
+                vint_t h_diag = VOP(shift1)(v_load(&h_load[seg_len-1]),
+                                            VOP(set1)(-(i - 1) * d));
+
+                for (int s = 0; s < seg_len; s++) {
+                        vint_t h = VOP(add)(h_diag, v_load(&p[s]));
+                        h = VOP(max)(h, VOP(sub)(v_load(&h_load[s]), vd));
+                        h = VOP(max)(h, f);
+                        v_store(&h_store[s], h);
+#if STRIPED_BITS < 32
+                        lo = VOP(min)(lo, h);
+                        hi = VOP(max)(hi, h);
+#endif
+                        f = VOP(sub)(h, vd);
+                        h_diag = v_load(&h_load[s]);
+                }
+
+                /* Lazy F: carry indels from the end of each segment
+                   into the next, until none improves a score */
+                f = VOP(shift1)(f, ninf);
+                int s = 0;
+                while (v_any(VOP(cmpgt)(f, v_load(&h_store[s])))) {
+                        v_store(&h_store[s],
+                                VOP(max)(v_load(&h_store[s]), f));
+                        f = VOP(max)(VOP(sub)(f, vd), ninf);
+                        if (++s == seg_len) {
+                                s = 0;
+                                f = VOP(shift1)(f, ninf);
+                        }
+                }
+
+                vint_t *t = h_load;
+                h_load = h_store;
+                h_store = t;
+        }
+
+        int j = query_len - 1;
+        *score = ((ELEM *)h_load)[(j % seg_len) * LANES + j / seg_len];
+
+        free(profile);
+        free(h_load);
+        free(h_store);
+
+#if STRIPED_BITS < 32
+        /* A score at either end of the lanes' range may have been
+           clipped.  (The lazy F loop only raises scores to values
+           already bounded by the ones seen here.) */
+        if (v_any(VOP(cmpgt)(VOP(set1)(ELEM_MIN + 1), lo)) ||
+            v_any(VOP(cmpgt)(hi, VOP(set1)(ELEM_MAX - 1)))) {
+                return 0;
+        }
+#endif
+        return 1;
+}
+
+#undef SP_CAT
+#undef SP_XCAT
+#undef VOP
+#undef ELEM
+#undef ELEM_MIN
+#undef ELEM_MAX
+#undef LANES
+#undef IN_RANGE
+#undef NEG_INF
@@ -0,0 +1,215 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * striped.c - Striped (Farrar) score-only engine.  Computes the optimal
+ *             alignment score of two sequences without building a
+ *             score table or walk table.  This file is compiled once
+ *             per vector extension (see simd.h and the Makefile); each
+ *             build defines striped_score_<isa>().
+ *
+ *             The top string is the query: it is cut into SIMD_LANES
+ *             segments of seg_len characters, and lane l of vector s
+ *             holds query position l*seg_len + s.  Each character of
+ *             the side string then scores one row of the table, held
+ *             in seg_len vectors.  Within a row, the diagonal and
+ *             above-row candidates are computed for all segments in
+ *             one pass; indels along the query are carried between
+ *             segments by F and fixed up afterwards by the "lazy F"
+ *             loop, which rarely runs more than a few vectors.
+ *
+ *             See Farrar, "Striped Smith-Waterman speeds database
+ *             searches six times over other SIMD implementations",
+ *             Bioinformatics 23(2), 2007.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dbg.h"
+#include "simd.h"
+#include "striped.h"
+
+#ifdef SIMD_LANES
+
+/*
+ * alloc_vectors()
+ *
+ *   Allocate n zeroed, suitably aligned vectors.
+ */
+static vint_t *
+alloc_vectors(size_t n)
+{
+        vint_t *v = aligned_alloc(sizeof(vint_t), n * sizeof(vint_t));
+        check(NULL != v, "aligned_alloc failed");
+        memset(v, 0, n * sizeof(vint_t));
+        return v;
+}
+
+/* One pass per score width; see striped-pass.h */
+#define STRIPED_BITS 8
+#include "striped-pass.h"
+#undef STRIPED_BITS
+
+#define STRIPED_BITS 16
+#include "striped-pass.h"
+#undef STRIPED_BITS
+
+#define STRIPED_BITS 32
+#include "striped-pass.h"
+#undef STRIPED_BITS
+
+/*
+ * fits_width()
+ *
+ *   Return nonzero if every score in the table aligning a top string of
+ *   length n1 to a side string of length n2 -- and every candidate
+ *   score one step away from one -- is strictly inside (lo, hi).
+ *
+ *   The cell at (i, j) scores no more than min(i, j) matches, and no
+ *   less than the path of min(i, j) mismatches (or, if cheaper, indel
+ *   pairs) followed by |i - j| indels.  If a parameter is negative we
+ *   settle for (n1 + n2) * max(|m|, |k|, |d|) either way.
+ */
+static int
+fits_width(long long n1, long long n2, int m, int k, int d, int lo, int hi)
+{
+        long long step = llabs(m);
+        if (llabs(k) > step)
+                step = llabs(k);
+        if (llabs(d) > step)
+                step = llabs(d);
+
+        long long least, most;
+        if (m < 0 || k < 0 || d < 0) {
+                most = (n1 + n2) * step;
+                least = -most;
+        } else {
+                long long short_side = n1 < n2 ? n1 : n2;
+                long long long_side = n1 < n2 ? n2 : n1;
+                long long mismatch = k < 2 * d ? k : 2 * d;
+                long long extra = mismatch > d ? mismatch - d : 0;
+                most = short_side * m;
+                least = -(long_side * d + short_side * extra);
+        }
+
+        return least - step > lo && most + step < hi;
+}
+
+/*
+ * striped_score_<isa>()
+ *
+ *   Compute the Needleman-Wunsch optimal alignment score of top and
+ *   side, i.e. the score the bottom-right cell of the score table
+ *   would hold.  We score in the narrowest lanes the scores are sure
+ *   to fit -- 8-bit lanes run four times as many cells per instruction
+ *   as 32-bit ones -- and should a narrow pass saturate anyway, repeat
+ *   it in wider lanes.
+ *
+ *   top, side - sequences to align
+ *
+ *   m, k, d - match bonus, mismatch penalty, and indel penalty
+ *
+ *   matrix - substitution matrix to score aligned characters with in
+ *            place of m and k, or NULL
+ *
+ *   return - the optimal score
+ */
+int
+SIMD_FN(striped_score)(const char *top,
+                       const char *side,
+                       int m,
+                       int k,
+                       int d,
+                       const substitution_matrix_t *matrix)
+{
+        int query_len = strlen(top);
+        int rows = strlen(side);
+
+        if (query_len == 0 || rows == 0) {
+                return -(query_len + rows) * d;
+        }
+
+        /* A substitution matrix bounds the scores as match bonus and
+           mismatch penalty of its highest and lowest scores would */
+        if (NULL != matrix) {
+                m = matrix->max_score;
+                k = -matrix->min_score;
+        }
+
+        /* Index of each distinct side-string character's row in the
+           query profile */
+        int profile_index[256];
+        int nchars = 0;
+        memset(profile_index, -1, sizeof(profile_index));
+        for (int i = 0; i < rows; i++) {
+                unsigned char c = side[i];
+                if (profile_index[c] < 0) {
+                        profile_index[c] = nchars++;
+                }
+        }
+
+        /* The query is padded to a whole number of segments, and the
+           padding is scored like the rest of the table */
+        int score;
+        int lanes = SIMD_LANES * 4;
+        long long padded = (query_len + lanes - 1) / lanes * lanes;
+        if (fits_width(padded, rows, m, k, d, INT8_MIN, INT8_MAX)) {
+                debug("Scoring in 8-bit lanes");
+                if (striped_pass_8(top, query_len, side, rows,
+                                   profile_index, nchars, m, k, d, matrix,
+                                   &score)) {
+                        return score;
+                }
+                debug("8-bit lanes saturated");
+        }
+
+        lanes = SIMD_LANES * 2;
+        padded = (query_len + lanes - 1) / lanes * lanes;
+        if (fits_width(padded, rows, m, k, d, INT16_MIN, INT16_MAX)) {
+                debug("Scoring in 16-bit lanes");
+                if (striped_pass_16(top, query_len, side, rows,
+                                    profile_index, nchars, m, k, d, matrix,
+                                    &score)) {
+                        return score;
+                }
+                debug("16-bit lanes saturated");
+        }
+
+        debug("Scoring in 32-bit lanes");
+        striped_pass_32(top, query_len, side, rows,
+                        profile_index, nchars, m, k, d, matrix, &score);
+        return score;
+}
+
+#endif /* SIMD_LANES */
@@ -0,0 +1,221 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * substitution-matrix.c - Read a substitution matrix from a file, and
+ *                         build the query profiles the column kernels
+ *                         score with.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dbg.h"
+#include "substitution-matrix.h"
+
+#define MATRIX_DELIMITERS " \t\r\n"
+
+/*
+ * read_substitution_matrix()
+ *
+ *   Read a substitution matrix from the file at path.  The file is in
+ *   the format NCBI distributes BLOSUM and PAM matrices in: lines
+ *   starting with '#' are comments, the first other line lists the
+ *   alphabet, one symbol per column, and each line after that starts
+ *   with a symbol and lists its scores against the symbols of the
+ *   header, in order.  Lowercase letters not in the alphabet score as
+ *   their uppercase forms.  We give up if the file is malformed.
+ */
+substitution_matrix_t *
+read_substitution_matrix(const char *path)
+{
+        FILE *in = fopen(path, "r");
+        check(NULL != in, "failed to open %s", path);
+
+        substitution_matrix_t *X = malloc(sizeof(substitution_matrix_t));
+        check(NULL != X, "malloc failed");
+        X->size = 0;
+        X->scores = NULL;
+        for (int c = 0; c <= UCHAR_MAX; c++) {
+                X->code[c] = -1;
+        }
+
+        /* Whether each symbol's row has been read yet */
+        char row_read[UCHAR_MAX + 1] = {0};
+        int rows = 0;
+
+        char *line = NULL;
+        size_t line_max = 0;
+        int line_no = 0;
+        while (-1 != getline(&line, &line_max, in)) {
+                line_no = line_no + 1;
+
+                char *tok = strtok(line, MATRIX_DELIMITERS);
+                if (NULL == tok || '#' == tok[0]) {
+                        continue;
+                }
+
+                /* The header: one symbol per column */
+                if (0 == X->size) {
+                        for (; NULL != tok;
+                             tok = strtok(NULL, MATRIX_DELIMITERS)) {
+                                unsigned char c = tok[0];
+                                check(1 == strlen(tok), "%s:%d: symbol %s "
+                                      "is not a single character",
+                                      path, line_no, tok);
+                                check(X->code[c] < 0, "%s:%d: symbol %c "
+                                      "is listed twice", path, line_no, c);
+                                X->code[c] = X->size;
+                                X->size = X->size + 1;
+                        }
+                        X->scores = malloc((size_t)X->size * X->size *
+                                           sizeof(int));
+                        check(NULL != X->scores, "malloc failed");
+                        continue;
+                }
+
+                /* A row: a symbol of the header, then its scores */
+                unsigned char c = tok[0];
+                check(1 == strlen(tok) && X->code[c] >= 0, "%s:%d: row "
+                      "symbol %s is not in the header", path, line_no, tok);
+                check(!row_read[c], "%s:%d: row %c is listed twice",
+                      path, line_no, c);
+                int *row = &X->scores[X->code[c] * X->size];
+                for (int b = 0; b < X->size; b++) {
+                        tok = strtok(NULL, MATRIX_DELIMITERS);
+                        check(NULL != tok, "%s:%d: row %c has fewer than "
+                              "%d scores", path, line_no, c, X->size);
+
+                        char *end;
+                        errno = 0;
+                        long score = strtol(tok, &end, 10);
+                        check(0 == errno && '\0' == *end &&
+                              score >= INT_MIN && score <= INT_MAX,
+                              "%s:%d: %s is not a score",
+                              path, line_no, tok);
+                        row[b] = (int)score;
+                }
+                check(NULL == strtok(NULL, MATRIX_DELIMITERS), "%s:%d: row "
+                      "%c has more than %d scores", path, line_no, c,
+                      X->size);
+                row_read[c] = 1;
+                rows = rows + 1;
+        }
+        check(0 == ferror(in), "failed to read %s", path);
+        free(line);
+        fclose(in);
+
+        errno = 0;
+        check(X->size > 0, "%s: no substitution matrix found", path);
+        check(rows == X->size, "%s: expected %d rows of scores but found %d",
+              path, X->size, rows);
+
+        for (int c = 'a'; c <= 'z'; c++) {
+                if (X->code[c] < 0) {
+                        X->code[c] = X->code[toupper(c)];
+                }
+        }
+
+        X->min_score = X->scores[0];
+        X->max_score = X->scores[0];
+        for (int i = 1; i < X->size * X->size; i++) {
+                if (X->min_score > X->scores[i])
+                        X->min_score = X->scores[i];
+                if (X->max_score < X->scores[i])
+                        X->max_score = X->scores[i];
+        }
+
+        return X;
+}
+
+/*
+ * check_matrix_alphabet()
+ *
+ *   Give up unless every character of s is in the alphabet of the
+ *   substitution matrix X.
+ */
+void
+check_matrix_alphabet(const substitution_matrix_t *X, const char *s)
+{
+        for (; '\0' != *s; s++) {
+                check(X->code[(unsigned char)*s] >= 0, "%c is not in the "
+                      "substitution matrix's alphabet", *s);
+        }
+}
+
+/*
+ * alloc_query_profile()
+ *
+ *   Build the query profile of side for the substitution matrix X.
+ *   The profile holds one row per symbol of the alphabet, each as long
+ *   as a column of the score table: entry r of symbol a's row is the
+ *   bonus for aligning a with side[r-1], and entry 0 is unused.  A
+ *   column kernel fetches the row of its top character once (see
+ *   query_profile_row()), and then scores each diagonal move with one
+ *   load instead of a comparison.
+ *
+ *   X - substitution matrix, whose alphabet side must be in
+ *
+ *   side - the side string
+ *
+ *   return - the profile, to be freed with free(3)
+ */
+int *
+alloc_query_profile(const substitution_matrix_t *X, const char *side)
+{
+        size_t N = strlen(side) + 1;
+        int *profile = malloc((size_t)X->size * N * sizeof(int));
+        check(NULL != profile, "malloc failed");
+
+        for (int a = 0; a < X->size; a++) {
+                int *row = &profile[a * N];
+                const int *scores = &X->scores[a * X->size];
+                row[0] = 0;
+                for (size_t r = 1; r < N; r++) {
+                        row[r] = scores[X->code[(unsigned char)side[r-1]]];
+                }
+        }
+
+        return profile;
+}
+
+/* Destroy a substitution matrix */
+void
+free_substitution_matrix(substitution_matrix_t *X)
+{
+        free(X->scores);
+        free(X);
+}
@@ -0,0 +1,92 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * substitution-matrix.h - Definition of a substitution matrix, which
+ *                         scores each pair of aligned characters, and
+ *                         prototypes for the functions implemented in
+ *                         substitution-matrix.c.
+ */
+
+#ifndef __SUBSTITUTION_MATRIX_H__
+#define __SUBSTITUTION_MATRIX_H__
+
+#include <limits.h>
+#include <stddef.h>
+
+/* substitution_matrix_t: Scores for aligning each symbol of an alphabet
+ *                        with each other one, read from a file in the
+ *                        NCBI format (see read_substitution_matrix()).
+ *                        Characters are mapped to their index in the
+ *                        alphabet, and scores[a * size + b] is the bonus
+ *                        for aligning symbol a of the top string with
+ *                        symbol b of the side string. */
+typedef struct substitution_matrix {
+        int size;                       /* symbols in the alphabet */
+        int code[UCHAR_MAX + 1];        /* index of each character, or -1 */
+        int *scores;
+        int min_score;
+        int max_score;
+} substitution_matrix_t;
+
+/* Return the bonus for aligning top character a with side character b */
+static inline int
+substitution_score(const substitution_matrix_t *X, char a, char b)
+{
+        return X->scores[X->code[(unsigned char)a] * X->size +
+                         X->code[(unsigned char)b]];
+}
+
+/* Return the query profile row of top character a (see
+   alloc_query_profile()), given the length of the side string */
+static inline const int *
+query_profile_row(const substitution_matrix_t *X,
+                  const int *profile,
+                  int side_len,
+                  char a)
+{
+        return &profile[(size_t)X->code[(unsigned char)a] * (side_len + 1)];
+}
+
+/*
+ * Prototypes
+ */
+
+substitution_matrix_t *read_substitution_matrix(const char *path);
+
+void check_matrix_alphabet(const substitution_matrix_t *X, const char *s);
+
+int *alloc_query_profile(const substitution_matrix_t *X, const char *side);
+
+void free_substitution_matrix(substitution_matrix_t *X);
+
+#endif /* __SUBSTITUTION_MATRIX_H__ */
@@ -0,0 +1,418 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * thread-pool.c - A work-stealing pool of worker threads.  Each worker
+ *                 runs tasks from the bottom of its own deque and,
+ *                 when that runs dry, steals from the top of the
+ *                 others' before going to sleep.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "dbg.h"
+#include "thread-pool.h"
+
+/* Starting number of tasks a deque can hold.  Must be a power of 2. */
+#define TASK_DEQUE_SIZE 64
+
+/* Index of the calling thread in its pool (declared in thread-pool.h),
+ * and the pool itself.  Both are unset outside of worker threads. */
+__thread int thread_pool_worker = -1;
+static __thread thread_pool_t *worker_pool = NULL;
+
+/* Arguments to each worker thread's initial function */
+struct worker_args {
+        thread_pool_t *P;
+        int id;
+};
+
+static void
+init_task_deque(task_deque_t *D)
+{
+        D->capacity = TASK_DEQUE_SIZE;
+        D->tasks = (task_t *)malloc(D->capacity * sizeof(task_t));
+        check(NULL != D->tasks, "malloc failed");
+        D->top = 0;
+        D->bottom = 0;
+        int res = pthread_mutex_init(&D->mutex, NULL);
+        check(0 == res, "pthread_mutex_init failed");
+}
+
+static void
+destroy_task_deque(task_deque_t *D)
+{
+        int res = pthread_mutex_destroy(&D->mutex);
+        check(0 == res, "pthread_mutex_destroy failed");
+        free(D->tasks);
+}
+
+/*
+ * push_bottom()
+ *
+ *   Push a task onto the bottom of a deque, doubling the deque if it is
+ *   full.  top and bottom only ever grow, so a task's slot is its index
+ *   modulo the capacity.
+ */
+static void
+push_bottom(task_deque_t *D, task_t t)
+{
+        pthread_mutex_lock(&D->mutex);
+
+        if (D->bottom - D->top == D->capacity) {
+                long capacity = D->capacity * 2;
+                task_t *tasks = (task_t *)malloc(capacity * sizeof(task_t));
+                check(NULL != tasks, "malloc failed");
+                for (long i = D->top; i < D->bottom; i++) {
+                        tasks[i & (capacity - 1)] = D->tasks[i & (D->capacity - 1)];
+                }
+                free(D->tasks);
+                D->tasks = tasks;
+                D->capacity = capacity;
+        }
+
+        D->tasks[D->bottom & (D->capacity - 1)] = t;
+        D->bottom = D->bottom + 1;
+
+        pthread_mutex_unlock(&D->mutex);
+}
+
+/*
+ * pop_bottom()
+ *
+ *   Pop the most recently pushed task off the bottom of a deque.
+ *
+ *   return - 1 if we got a task, 0 if the deque was empty
+ */
+static int
+pop_bottom(task_deque_t *D, task_t *t)
+{
+        int got = 0;
+
+        pthread_mutex_lock(&D->mutex);
+        if (D->bottom > D->top) {
+                D->bottom = D->bottom - 1;
+                *t = D->tasks[D->bottom & (D->capacity - 1)];
+                got = 1;
+        }
+        pthread_mutex_unlock(&D->mutex);
+
+        return got;
+}
+
+/*
+ * steal_top()
+ *
+ *   Take the oldest task off the top of another worker's deque.
+ *
+ *   return - 1 if we got a task, 0 if the deque was empty
+ */
+static int
+steal_top(task_deque_t *D, task_t *t)
+{
+        int got = 0;
+
+        pthread_mutex_lock(&D->mutex);
+        if (D->bottom > D->top) {
+                *t = D->tasks[D->top & (D->capacity - 1)];
+                D->top = D->top + 1;
+                got = 1;
+        }
+        pthread_mutex_unlock(&D->mutex);
+
+        return got;
+}
+
+/*
+ * take_task()
+ *
+ *   Find a task for worker id: first from its own deque, then from each
+ *   of the other workers' deques in turn.
+ *
+ *   return - 1 if we got a task, 0 if every deque was empty
+ */
+static int
+take_task(thread_pool_t *P, int id, task_t *t)
+{
+        int got = pop_bottom(&P->deques[id], t);
+
+        for (unsigned int k = 1; !got && k < P->num_workers; k++) {
+                got = steal_top(&P->deques[(id + k) % P->num_workers], t);
+        }
+
+        if (got) {
+                atomic_fetch_sub(&P->queued, 1);
+        }
+
+        return got;
+}
+
+/*
+ * run_worker()
+ *
+ *   Initial function of each worker thread.  Run tasks until the pool
+ *   shuts down, sleeping whenever there is nothing to run or steal.
+ *
+ *   args - pointer to the worker's struct worker_args
+ */
+static void *
+run_worker(void *args)
+{
+        struct worker_args *A = (struct worker_args *)args;
+        thread_pool_t *P = A->P;
+        task_t t;
+
+        thread_pool_worker = A->id;
+        worker_pool = P;
+
+        for (;;) {
+                if (take_task(P, thread_pool_worker, &t)) {
+                        t.run(P, t.arg, t.item);
+
+                        /* Wake thread_pool_wait() if that was the last
+                           outstanding task */
+                        if (1 == atomic_fetch_sub(&P->pending, 1)) {
+                                pthread_mutex_lock(&P->mutex);
+                                pthread_cond_broadcast(&P->done_cv);
+                                pthread_mutex_unlock(&P->mutex);
+                        }
+                        continue;
+                }
+
+                /* Nothing to do.  We count ourselves as a sleeper before
+                   checking the queue, and submitters queue a task
+                   before checking for sleepers, so one of us always
+                   sees the other and no wakeup is lost. */
+                pthread_mutex_lock(&P->mutex);
+                atomic_fetch_add(&P->sleepers, 1);
+                if (!P->shutdown && 0 == atomic_load(&P->queued)) {
+                        pthread_cond_wait(&P->work_cv, &P->mutex);
+                }
+                atomic_fetch_sub(&P->sleepers, 1);
+                int stop = P->shutdown;
+                pthread_mutex_unlock(&P->mutex);
+
+                if (stop) {
+                        break;
+                }
+        }
+
+        return NULL;
+}
+
+/*
+ * alloc_thread_pool()
+ *
+ *   Allocate a pool and start its worker threads.
+ *
+ *   num_workers - number of worker threads to start
+ *
+ *   return - allocated thread_pool_t pointer
+ */
+thread_pool_t *
+alloc_thread_pool(unsigned int num_workers)
+{
+        int res;
+        thread_pool_t *P = (thread_pool_t *)malloc(sizeof(thread_pool_t));
+        check(NULL != P, "malloc failed");
+
+        P->num_workers = num_workers;
+        P->workers = (pthread_t *)malloc(num_workers * sizeof(pthread_t));
+        check(NULL != P->workers, "malloc failed");
+        P->deques = (task_deque_t *)malloc(num_workers * sizeof(task_deque_t));
+        check(NULL != P->deques, "malloc failed");
+        P->args = (struct worker_args *)malloc(num_workers * sizeof(struct worker_args));
+        check(NULL != P->args, "malloc failed");
+
+        for (unsigned int i = 0; i < num_workers; i++) {
+                init_task_deque(&P->deques[i]);
+        }
+
+        atomic_init(&P->queued, 0);
+        atomic_init(&P->pending, 0);
+        atomic_init(&P->sleepers, 0);
+        atomic_init(&P->next_deque, 0);
+        P->shutdown = 0;
+        res = pthread_mutex_init(&P->mutex, NULL);
+        check(0 == res, "pthread_mutex_init failed");
+        res = pthread_cond_init(&P->work_cv, NULL);
+        check(0 == res, "pthread_cond_init failed");
+        res = pthread_cond_init(&P->done_cv, NULL);
+        check(0 == res, "pthread_cond_init failed");
+
+        debug("Spawning %u worker threads", num_workers);
+        for (unsigned int i = 0; i < num_workers; i++) {
+                P->args[i].P = P;
+                P->args[i].id = i;
+                res = pthread_create(&P->workers[i], NULL, run_worker, &P->args[i]);
+                check(0 == res, "pthread_create failed");
+        }
+
+        return P;
+}
+
+/*
+ * free_thread_pool()
+ *
+ *   Stop and join a pool's worker threads, then free the pool.  Any
+ *   submitted tasks should be finished first (see thread_pool_wait()).
+ */
+void
+free_thread_pool(thread_pool_t *P)
+{
+        int res;
+
+        pthread_mutex_lock(&P->mutex);
+        P->shutdown = 1;
+        pthread_cond_broadcast(&P->work_cv);
+        pthread_mutex_unlock(&P->mutex);
+
+        for (unsigned int i = 0; i < P->num_workers; i++) {
+                res = pthread_join(P->workers[i], NULL);
+                check(0 == res, "pthread_join failed");
+        }
+        debug("Joined %u worker threads", P->num_workers);
+
+        for (unsigned int i = 0; i < P->num_workers; i++) {
+                destroy_task_deque(&P->deques[i]);
+        }
+        res = pthread_mutex_destroy(&P->mutex);
+        check(0 == res, "pthread_mutex_destroy failed");
+        res = pthread_cond_destroy(&P->work_cv);
+        check(0 == res, "pthread_cond_destroy failed");
+        res = pthread_cond_destroy(&P->done_cv);
+        check(0 == res, "pthread_cond_destroy failed");
+
+        free(P->workers);
+        free(P->deques);
+        free(P->args);
+        free(P);
+}
+
+/*
+ * thread_pool_submit()
+ *
+ *   Queue the task run(P, arg, item).  A worker of P queues onto its
+ *   own deque, so the tasks it spawns stay local unless someone steals
+ *   them.  Anyone else spreads tasks over the deques round-robin.
+ *
+ *   P - target pool
+ *
+ *   run - function to run
+ *
+ *   arg - argument shared by tasks of the same kind
+ *
+ *   item - argument identifying this particular task
+ */
+void
+thread_pool_submit(thread_pool_t *P,
+                   void (*run)(thread_pool_t *, void *, long),
+                   void *arg,
+                   long item)
+{
+        task_t t = { run, arg, item };
+        unsigned int id;
+
+        if (worker_pool == P) {
+                id = thread_pool_worker;
+        } else {
+                id = atomic_fetch_add(&P->next_deque, 1) % P->num_workers;
+        }
+
+        atomic_fetch_add(&P->pending, 1);
+        atomic_fetch_add(&P->queued, 1);
+        push_bottom(&P->deques[id], t);
+
+        if (atomic_load(&P->sleepers) > 0) {
+                pthread_mutex_lock(&P->mutex);
+                pthread_cond_signal(&P->work_cv);
+                pthread_mutex_unlock(&P->mutex);
+        }
+}
+
+/*
+ * thread_pool_wait()
+ *
+ *   Block until every task submitted to the pool, including tasks
+ *   submitted by other tasks, has finished.
+ */
+void
+thread_pool_wait(thread_pool_t *P)
+{
+        pthread_mutex_lock(&P->mutex);
+        while (atomic_load(&P->pending) > 0) {
+                pthread_cond_wait(&P->done_cv, &P->mutex);
+        }
+        pthread_mutex_unlock(&P->mutex);
+}
+
+/*
+ * init_pool_counter()
+ *
+ *   Initialize the counter K to 0, with a slot for each of num_workers
+ *   workers and one for threads outside the pool.
+ */
+void
+init_pool_counter(pool_counter_t *K, unsigned int num_workers)
+{
+        K->num_slots = num_workers + 1;
+        K->slots = (pool_counter_slot_t *)aligned_alloc(
+                CACHE_LINE_SIZE, K->num_slots * sizeof(pool_counter_slot_t));
+        check(NULL != K->slots, "aligned_alloc failed");
+        for (unsigned int i = 0; i < K->num_slots; i++) {
+                atomic_init(&K->slots[i].count, 0);
+        }
+}
+
+void
+free_pool_counter(pool_counter_t *K)
+{
+        free(K->slots);
+}
+
+/*
+ * pool_counter_sum()
+ *
+ *   return - the count held by K, summed over its slots
+ */
+unsigned long
+pool_counter_sum(pool_counter_t *K)
+{
+        unsigned long sum = 0;
+        for (unsigned int i = 0; i < K->num_slots; i++) {
+                sum = sum + atomic_load_explicit(&K->slots[i].count,
+                                                 memory_order_relaxed);
+        }
+        return sum;
+}
@@ -0,0 +1,168 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * thread-pool.h - Definition of a work-stealing pool of worker threads
+ *                 and prototypes for functions implemented in
+ *                 thread-pool.c.
+ */
+
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+struct thread_pool;
+struct worker_args;
+
+/* task_t: A unit of work.  run is called as run(P, arg, item) on
+ *         whichever worker picks the task up; it may submit more
+ *         tasks to P. */
+typedef struct task {
+        void (*run)(struct thread_pool *P, void *arg, long item);
+        void *arg;
+        long item;
+} task_t;
+
+/* task_deque_t: A worker's double-ended queue of tasks.  The owner
+ *               pushes and pops at the bottom; thieves take from the
+ *               top, so they get the oldest (and usually largest)
+ *               pieces of work. */
+typedef struct task_deque {
+        task_t *tasks;
+        long capacity;
+        long top;
+        long bottom;
+        pthread_mutex_t mutex;
+} task_deque_t;
+
+/* thread_pool_t: A fixed set of worker threads, each with its own
+ *                deque.  An idle worker steals from the others before
+ *                going to sleep. */
+typedef struct thread_pool {
+        unsigned int num_workers;
+        pthread_t *workers;
+        struct worker_args *args;
+        task_deque_t *deques;
+
+        /* Tasks sitting in deques, and tasks submitted but not yet
+         * finished */
+        atomic_long queued;
+        atomic_long pending;
+
+        /* Idle workers sleep on work_cv; thread_pool_wait() sleeps on
+         * done_cv */
+        atomic_int sleepers;
+        int shutdown;
+        pthread_mutex_t mutex;
+        pthread_cond_t work_cv;
+        pthread_cond_t done_cv;
+
+        /* Deque that submissions from outside the pool go to next */
+        atomic_uint next_deque;
+} thread_pool_t;
+
+/* Bytes in a cache line, to keep data that different workers write
+   from sharing one */
+#define CACHE_LINE_SIZE 64
+
+/* pool_counter_t: A count that workers add to without contending.
+ *                 Each worker adds to its own slot, on its own cache
+ *                 line; threads outside the pool share the last slot.
+ *                 Reading the count sums the slots. */
+typedef struct pool_counter_slot {
+        _Alignas(CACHE_LINE_SIZE) atomic_ulong count;
+} pool_counter_slot_t;
+
+typedef struct pool_counter {
+        unsigned int num_slots;
+        pool_counter_slot_t *slots;
+} pool_counter_t;
+
+/*
+ * Prototypes
+ */
+
+thread_pool_t *alloc_thread_pool(unsigned int num_workers);
+
+void free_thread_pool(thread_pool_t *P);
+
+void thread_pool_submit(thread_pool_t *P,
+                        void (*run)(thread_pool_t *, void *, long),
+                        void *arg,
+                        long item);
+
+void thread_pool_wait(thread_pool_t *P);
+
+void init_pool_counter(pool_counter_t *K, unsigned int num_workers);
+
+void free_pool_counter(pool_counter_t *K);
+
+unsigned long pool_counter_sum(pool_counter_t *K);
+
+/* Index of the calling worker thread in its pool, or -1 if the caller
+   is not a worker thread.  Defined in thread-pool.c. */
+extern __thread int thread_pool_worker;
+
+/*
+ * thread_pool_worker_id()
+ *
+ *   return - index of the calling worker thread in its pool, or -1 if
+ *            the caller is not a worker thread
+ */
+static inline int
+thread_pool_worker_id(void)
+{
+        return thread_pool_worker;
+}
+
+/*
+ * pool_counter_add()
+ *
+ *   Add n to the calling thread's slot of the counter K.  A slot has
+ *   only one writer unless threads outside the pool share it, so the
+ *   add is uncontended and needs no ordering.
+ */
+static inline void
+pool_counter_add(pool_counter_t *K, unsigned long n)
+{
+        int id = thread_pool_worker_id();
+        unsigned int slot = K->num_slots - 1;
+        if (id >= 0 && (unsigned int)id < slot) {
+                slot = (unsigned int)id;
+        }
+        atomic_fetch_add_explicit(&K->slots[slot].count, n,
+                                  memory_order_relaxed);
+}
+
+#endif /* __THREAD_POOL_H__ */
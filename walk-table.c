@@ -38,7 +38,6 @@
  *                table in the Needleman Wunsch algorithm.
  */
 
-#include <pthread.h>
 #include <stdlib.h>
 
 #include "dbg.h"
@@ -53,10 +52,15 @@
  *
  *   N - number of rows in the matrix
  *
+ *   band - half-width of the band of cells to store, or -1 to store
+ *          every cell
+ *
+ *   nthreads - number of threads that may mark the table's cells
+ *
  *   return - allocated pointer to a walk_table_t
  */
 walk_table_t *
-alloc_walk_table(int M, int N)
+alloc_walk_table(int M, int N, int band, unsigned int nthreads)
 {
         /* Allocate for the walk table */
         walk_table_t *W = (walk_table_t *)malloc(sizeof(walk_table_t));
@@ -65,60 +69,37 @@ alloc_walk_table(int M, int N)
         W->M = M;
         W->N = N;
 
-        /* Allocate top-level array for T->cells */
-        W->cells = (walk_table_cell_t **)malloc(M * sizeof(walk_table_cell_t *));
-        check(NULL != W->cells, "malloc failed");
-
-        /* Allocate subarrays for T->cells */
-        for (int i = 0; i < M; i++) {
-                W->cells[i] = (walk_table_cell_t *)calloc(N, sizeof(walk_table_cell_t));
-                check(NULL != W->cells[i], "malloc failed");
+        /* Allocate every cell in one column-major block, or just the
+           band and the cells bordering it */
+        size_t column_size = N;
+        W->column_step = N;
+        W->column_skew = 0;
+        if (band >= 0) {
+                column_size = 2 * (size_t)band + 3;
+                W->column_step = column_size - 1;
+                W->column_skew = (size_t)band + 1;
         }
+        W->cells = (walk_table_cell_t *)calloc((size_t)M * column_size,
+                                               sizeof(walk_table_cell_t));
+        check(NULL != W->cells, "calloc failed");
+
+        init_pool_counter(&W->branch_count, nthreads);
 
         return W;
 }
 
 void
-free_walk_table(walk_table_t *W, unsigned int nthreads)
+free_walk_table(walk_table_t *W)
 {
-        /* Free each subarray (column) of walk_table_cells */
-        for (int i = 0; i < W->M; i++) {
-                free(W->cells[i]);
-        }
-
-        /* Free the top-level array of walk_table_cell_t pointers */
+        /* Free the block of walk_table_cells */
         free(W->cells);
 
-        if (nthreads > 1) {
-                int res = pthread_rwlock_destroy(&W->branch_count_rwlock);
-                check(0 == res, "pthread_rwlock_destroy failed");
-        }
+        free_pool_counter(&W->branch_count);
 
         /* Free the walk table itself */
         free(W);
 }
 
-/*
- * inc_branch_count()
- *
- *   Increment the branch count for the given walk table.
- *
- *   W - target walk table
- */
-void
-inc_branch_count(walk_table_t *W, unsigned int nthreads)
-{
-        if (nthreads > 1) {
-                pthread_rwlock_wrlock(&W->branch_count_rwlock);
-        }
-
-        W->branch_count = W->branch_count + 1;
-
-        if (nthreads > 1) {
-                pthread_rwlock_unlock(&W->branch_count_rwlock);
-        }
-}
-
 /*
  * get_branch_count()
  *
@@ -128,20 +109,8 @@ inc_branch_count(walk_table_t *W, unsigned int nthreads)
  *
  *   return - the walk table's branch count
  */
-unsigned int
-get_branch_count(walk_table_t *W, unsigned int nthreads)
+unsigned long
+get_branch_count(walk_table_t *W)
 {
-        unsigned int count;
-
-        if (nthreads > 1) {
-                pthread_rwlock_rdlock(&W->branch_count_rwlock);
-        }
-
-        count = W->branch_count;
-
-        if (nthreads > 1) {
-                pthread_rwlock_unlock(&W->branch_count_rwlock);
-        }
-
-        return count;
+        return pool_counter_sum(&W->branch_count);
 }
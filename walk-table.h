@@ -39,43 +39,157 @@
 #ifndef __WALK_TABLE_H__
 #define __WALK_TABLE_H__
 
-#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "thread-pool.h"
 
 /* arrow_t: Directions in a walk_table_t. */
 typedef enum {left, up, diag} arrow_t;
 
-/* walk_table_cell_t: Cell in a walk_table_t. */
-typedef struct walk_table_cell {
-        int diag;
-        int left;
-        int up;
-        int diag_done;
-        int left_done;
-        int up_done;
-        arrow_t src_direction;
-        int in_optimal_path;
-} walk_table_cell_t;
+/* walk_bit_t: Bits of a walk_table_cell_t saying which directions out
+ *             of the cell are on an optimal path, and whether the cell
+ *             is on a constructed alignment (for -t). */
+typedef enum {
+        walk_diag = 1,
+        walk_up = 2,
+        walk_left = 4,
+        walk_optimal = 128
+} walk_bit_t;
+
+/* gap_move_t: With affine gaps, the moves that may end a gap at a cell.
+ *             A gap opens after an aligned cell or extends a gap in the
+ *             same direction.  These are bits of a walk_table_cell_t
+ *             too, between the walk_bit_t directions and walk_optimal. */
+typedef enum {
+        left_gap_open = 8,
+        left_gap_extend = 16,
+        up_gap_open = 32,
+        up_gap_extend = 64
+} gap_move_t;
+
+/* walk_table_cell_t: Cell in a walk_table_t, a byte of walk_bit_t and
+ *                    gap_move_t bits.  With affine gaps, the direction
+ *                    bits say how the best alignment ending at the cell
+ *                    ends (left and up meaning in a gap), and the
+ *                    gap_move_t bits say how those gaps arrive.  The
+ *                    state of a walk through the table is kept by the
+ *                    walk itself, not in the cells. */
+typedef uint8_t walk_table_cell_t;
 
 /* walk_table_t: An MxN table of walk_table_cells (i.e. matrix of
- *               walk_table_cell_t). */
+ *               walk_table_cell_t).  The cells live in a single
+ *               column-major allocation; use walk_table_cell() to
+ *               address them.  A banded walk table lays its cells out
+ *               like a banded score table (see score-table.h). */
 typedef struct walk_table {
         int M;
         int N;
-        walk_table_cell_t **cells;
-        unsigned int branch_count;
-        pthread_rwlock_t branch_count_rwlock;
+        size_t column_step;
+        size_t column_skew;
+        walk_table_cell_t *cells;
+        pool_counter_t branch_count;
 } walk_table_t;
 
+/*
+ * walk_table_cell()
+ *
+ *   Return a pointer to the cell at (col, row).
+ */
+static inline walk_table_cell_t *
+walk_table_cell(walk_table_t *W, int col, int row)
+{
+        return &W->cells[(size_t)col * W->column_step + W->column_skew + row];
+}
+
 /*
  * Prototypes
  */
 
-walk_table_t *alloc_walk_table(int M, int N);
+walk_table_t *alloc_walk_table(int M,
+                               int N,
+                               int band,
+                               unsigned int nthreads);
+
+void free_walk_table(walk_table_t *W);
+
+/*
+ * inc_branch_count()
+ *
+ *   Increment the branch count for the given walk table, in the
+ *   calling thread's slot of it.  Only debug builds report the count,
+ *   so other builds don't keep it.
+ *
+ *   W - target walk table
+ */
+static inline void
+inc_branch_count(walk_table_t *W)
+{
+#ifndef NDEBUG
+        pool_counter_add(&W->branch_count, 1);
+#else
+        (void)W;
+#endif
+}
+
+/*
+ * mark_walk_cell()
+ *
+ *   Record which directions out of the cell at (col, row) are on an
+ *   optimal path.  If more than one direction is optimal, the cell is
+ *   a branch.  W is NULL if the computation keeps no walk table, and
+ *   then nothing is recorded.
+ */
+static inline void
+mark_walk_cell(walk_table_t *W,
+               int col,
+               int row,
+               int diag,
+               int up,
+               int left)
+{
+        if (NULL == W) {
+                return;
+        }
+
+        *walk_table_cell(W, col, row) =
+                (diag ? walk_diag : 0) |
+                (up ? walk_up : 0) |
+                (left ? walk_left : 0);
+
+        if (diag + up + left > 1) {
+                inc_branch_count(W);
+        }
+}
+
+/*
+ * mark_affine_walk_cell()
+ *
+ *   Like mark_walk_cell(), and also record the gap_move_t bits in gaps.
+ *   A gap that may both open and extend into the cell is a branch too.
+ */
+static inline void
+mark_affine_walk_cell(walk_table_t *W,
+                      int col,
+                      int row,
+                      int diag,
+                      int up,
+                      int left,
+                      int gaps)
+{
+        if (NULL == W) {
+                return;
+        }
 
-void free_walk_table(walk_table_t *W, unsigned int nthreads);
+        mark_walk_cell(W, col, row, diag, up, left);
+        *walk_table_cell(W, col, row) |= gaps;
 
-void inc_branch_count(walk_table_t *W, unsigned int nthreads);
+        if (((gaps & left_gap_open) && (gaps & left_gap_extend)) ||
+            ((gaps & up_gap_open) && (gaps & up_gap_extend))) {
+                inc_branch_count(W);
+        }
+}
 
-unsigned int get_branch_count(walk_table_t *W, unsigned int nthreads);
+unsigned long get_branch_count(walk_table_t *W);
 
 #endif /* __WALK_TABLE_H__ */
@@ -0,0 +1,191 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * wavefront.c - Routines for allocating the tile grid of a parallel
+ *               score table fill and for tracking which of its tiles
+ *               are ready to be scored.
+ */
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "dbg.h"
+#include "wavefront.h"
+
+/*
+ * tile_side()
+ *
+ *   Pick the length of a tile's side along a dimension of n cells so
+ *   that about 4 tiles per thread fit along it, within
+ *   [WAVEFRONT_TILE_MIN, WAVEFRONT_TILE_MAX].  The number of tiles that
+ *   can be scored at once is bounded by the shorter side of the tile
+ *   grid, so a table that is much longer than it is wide gets tiles
+ *   that are much longer than they are wide too.
+ */
+static int
+tile_side(int n, unsigned int nthreads)
+{
+        int side = (n + 4 * nthreads - 1) / (4 * nthreads);
+        if (side < WAVEFRONT_TILE_MIN) {
+                side = WAVEFRONT_TILE_MIN;
+        }
+        if (side > WAVEFRONT_TILE_MAX) {
+                side = WAVEFRONT_TILE_MAX;
+        }
+        return side;
+}
+
+/*
+ * alloc_wavefront()
+ *
+ *   Allocate the tile grid for an MxN score table.  Row 0 and column 0
+ *   are seeded before the fill starts, so only cells (1..M-1, 1..N-1)
+ *   are covered by tiles.
+ *
+ *   M - number of columns in the score table
+ *
+ *   N - number of rows in the score table
+ *
+ *   nthreads - number of threads that will score the tiles
+ *
+ *   return - allocated wavefront_t pointer
+ */
+wavefront_t *
+alloc_wavefront(int M, int N, unsigned int nthreads)
+{
+        wavefront_t *F = (wavefront_t *)malloc(sizeof(wavefront_t));
+        check(NULL != F, "malloc failed");
+
+        F->M = M;
+        F->N = N;
+        F->tile_cols = tile_side(M - 1, nthreads);
+        F->tile_rows = tile_side(N - 1, nthreads);
+        F->tiles_x = (M - 1 + F->tile_cols - 1) / F->tile_cols;
+        F->tiles_y = (N - 1 + F->tile_rows - 1) / F->tile_rows;
+        int ntiles = F->tiles_x * F->tiles_y;
+
+        F->deps = (atomic_int *)malloc(ntiles * sizeof(atomic_int));
+        check(NULL != F->deps, "malloc failed");
+
+        /* A tile waits on the tile to its left and the tile above it.
+           Its diagonal neighbour is done before either of those. */
+        for (int ty = 0; ty < F->tiles_y; ty++) {
+                for (int tx = 0; tx < F->tiles_x; tx++) {
+                        atomic_init(&F->deps[ty * F->tiles_x + tx],
+                                    (tx > 0) + (ty > 0));
+                }
+        }
+
+        return F;
+}
+
+/*
+ * free_wavefront()
+ *
+ *   Destroy a tile grid.
+ */
+void
+free_wavefront(wavefront_t *F)
+{
+        free(F->deps);
+        free(F);
+}
+
+/*
+ * tile_bounds()
+ *
+ *   Compute the (inclusive) range of columns and rows of the score
+ *   table covered by a tile.
+ *
+ *   F - tile grid
+ *
+ *   tile - index of the tile
+ *
+ *   first_col, last_col, first_row, last_row - output bounds
+ */
+void
+tile_bounds(wavefront_t *F,
+            int tile,
+            int *first_col,
+            int *last_col,
+            int *first_row,
+            int *last_row)
+{
+        int tx = tile % F->tiles_x;
+        int ty = tile / F->tiles_x;
+
+        *first_col = 1 + tx * F->tile_cols;
+        *last_col = *first_col + F->tile_cols - 1;
+        if (*last_col > F->M - 1) {
+                *last_col = F->M - 1;
+        }
+
+        *first_row = 1 + ty * F->tile_rows;
+        *last_row = *first_row + F->tile_rows - 1;
+        if (*last_row > F->N - 1) {
+                *last_row = F->N - 1;
+        }
+}
+
+/*
+ * finish_tile()
+ *
+ *   Mark a tile done, retiring one dependency of the tile to its right
+ *   and of the tile below it.
+ *
+ *   F - tile grid
+ *
+ *   tile - index of the tile the caller finished scoring
+ *
+ *   ready - filled with the indices of the tiles that this made ready
+ *
+ *   return - number of indices written to ready
+ */
+int
+finish_tile(wavefront_t *F, int tile, int ready[2])
+{
+        int tx = tile % F->tiles_x;
+        int ty = tile / F->tiles_x;
+        int n = 0;
+
+        if (ty + 1 < F->tiles_y &&
+            1 == atomic_fetch_sub(&F->deps[tile + F->tiles_x], 1)) {
+                ready[n++] = tile + F->tiles_x;
+        }
+        if (tx + 1 < F->tiles_x &&
+            1 == atomic_fetch_sub(&F->deps[tile + 1], 1)) {
+                ready[n++] = tile + 1;
+        }
+
+        return n;
+}
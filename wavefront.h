@@ -0,0 +1,86 @@
+/*-
+ * Copyright (c) 2015, Scott Cheloha.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * wavefront.h - Definition of the tile grid that orders a parallel fill
+ *               of the score table.  Contains prototypes for functions
+ *               implemented in wavefront.c.
+ */
+
+#ifndef __WAVEFRONT_H__
+#define __WAVEFRONT_H__
+
+#include <stdatomic.h>
+
+/* Bounds, in cells, on either side of a tile of the score table.  A
+ * tile is the unit of work handed to a thread during a parallel fill. */
+#define WAVEFRONT_TILE_MAX 256
+#define WAVEFRONT_TILE_MIN 16
+
+/* wavefront_t: The score table (minus its seeded top row and left
+ *              column) cut into tiles.  A tile may be scored once the
+ *              tiles above it and to its left are done; each tile
+ *              counts its unfinished dependencies in deps. */
+typedef struct wavefront {
+        /* Table dimensions (see score_table_t) */
+        int M;
+        int N;
+
+        /* Size of a tile in cells, and number of tiles across and down
+         * the table */
+        int tile_cols;
+        int tile_rows;
+        int tiles_x;
+        int tiles_y;
+
+        /* Unfinished dependencies (0, 1, or 2) per tile */
+        atomic_int *deps;
+} wavefront_t;
+
+/*
+ * Prototypes
+ */
+
+wavefront_t *alloc_wavefront(int M, int N, unsigned int nthreads);
+
+void free_wavefront(wavefront_t *F);
+
+void tile_bounds(wavefront_t *F,
+                 int tile,
+                 int *first_col,
+                 int *last_col,
+                 int *first_row,
+                 int *last_row);
+
+int finish_tile(wavefront_t *F, int tile, int ready[2]);
+
+#endif /* __WAVEFRONT_H__ */